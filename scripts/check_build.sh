@@ -35,6 +35,14 @@ cmake --build . --config Release --parallel
 
 popd
 
+mkdir -p build-stats
+pushd build-stats
+
+cmake -G "Unix Makefiles" ../.. -DCMAKE_BUILD_TYPE=Debug -DCMAKE_CXX_COMPILER=clang++ -DHASH_SET_STATS=ON
+cmake --build . --config Debug --parallel
+
+popd
+
 mkdir -p build-debug
 pushd build-debug
 
@@ -9,3 +9,26 @@ set -x
 ./temp/build-release/demo_coarse_grained 8 4 100000
 ./temp/build-release/demo_striped 8 4 100000
 ./temp/build-release/demo_refinable 8 4 100000
+./temp/build-release/demo_striped 8 4 100000 --incremental-resize
+./temp/build-release/demo_refinable 8 4 100000 --incremental-resize
+./temp/build-release/demo_striped 8 4 100000 --batched
+./temp/build-release/demo_refinable 8 4 100000 --batched
+./temp/build-release/demo_lock_free 8 4 100000
+./temp/build-release/demo_flat_striped 8 4 100000
+./temp/build-release/demo_cuckoo 8 4 100000
+./temp/build-release/demo_striped_rw 8 4 100000
+./temp/build-release/demo_refinable_rw 8 4 100000
+./temp/build-release/demo_striped_slab 8 4 100000
+./temp/build-release/demo_striped_spin 8 4 100000
+./temp/build-release/demo_refinable_spin 8 4 100000
+./temp/build-release/demo_striped 8 4 100000 --workload=zipfian --mix=90:5:5
+./temp/build-release/demo_refinable 8 4 100000 --workload=hot-set --mix=90:5:5
+./temp/build-release/demo_striped_rw 8 4 100000 --workload=uniform --mix=98:1:1
+./temp/build-release/demo_striped 8 4 100000 --latency
+./temp/build-release/demo_refinable 8 4 100000 --latency --incremental-resize
+./temp/build-release/demo_striped 8 4 100000 --workload=uniform --mix=10:30:60
+./temp/build-release/demo_refinable 8 4 100000 --workload=uniform --mix=10:30:60 --incremental-resize --max-load-factor=8 --min-load-factor=2
+./temp/build-release/demo_striped 8 4 100000 --virtual
+./temp/build-release/demo_numa_striped 8 4 100000 --pin=nodes
+./temp/build-release/demo_striped 8 4 100000 --pin=cores
+./temp/build-release/demo_striped 8 4 100000 --max-lock-count=4
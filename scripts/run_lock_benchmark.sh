@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+
+set -e
+set -u
+set -x
+
+./scripts/check_build.sh
+
+# Compares the spin-then-park stripe locks with std::mutex, from a few locks
+# shared by every thread to the default lock cap, where threads rarely meet.
+# Each demo starts with 4 locks, and grows to at most --max-lock-count.
+for threads in 4 16 64; do
+  for max_lock_count in 4 64 4096; do
+    for demo in striped striped_spin refinable refinable_spin; do
+      ./temp/build-release/demo_${demo} ${threads} 4 0 --workload=hot-set \
+        --mix=50:25:25 --key-space=100000 --duration-ms=1000 \
+        --max-lock-count=${max_lock_count} --output=csv
+    done
+  done
+done
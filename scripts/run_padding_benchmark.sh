@@ -0,0 +1,16 @@
+#!/usr/bin/env bash
+
+set -e
+set -u
+set -x
+
+./scripts/check_build.sh
+
+# Compares cache-line-padded stripe mutexes with densely packed ones as the
+# thread count grows.
+for threads in 16 32 64; do
+  ./temp/build-release/demo_striped ${threads} 64 20000
+  ./temp/build-release/demo_striped_unpadded ${threads} 64 20000
+  ./temp/build-release/demo_refinable ${threads} 64 20000
+  ./temp/build-release/demo_refinable_unpadded ${threads} 64 20000
+done
@@ -0,0 +1,171 @@
+#!/usr/bin/env bash
+
+# Sweeps the concurrent demos over thread counts, initial capacities and
+# operation mixes, and reports the median throughput and the speedup over the
+# smallest thread count of each. Every configuration runs once as a warmup and
+# then REPETITIONS times, each for DURATION_MS on a fixed key space, so that
+# runs with different thread counts do the same work per operation.
+#
+# It writes to OUTPUT_DIR:
+#   runs.csv      every measured run;
+#   summary.csv   the median of each configuration, with its speedup;
+#   summary.json  the same as a JSON array.
+#
+# If the BASELINE file exists, a summary.csv kept from an earlier sweep on the
+# same machine, each median is compared with it, and the script fails if any
+# is more than TOLERANCE_PERCENT below its baseline. UPDATE_BASELINE=1 stores
+# the new summary as the baseline instead. The demos are built by
+# check_build.sh unless BUILD_DIR points to a release build already.
+#
+# The variables below can all be set in the environment, e.g.
+#   THREADS="1 2 4" MIXES="90:5:5" ./scripts/run_scaling_benchmark.sh
+
+set -e
+set -u
+set -x
+set -o pipefail
+
+test -d src/
+
+THREADS=${THREADS:-$(n=1; while [ "$n" -lt "$(nproc)" ]; do echo -n "$n "; n=$((n * 2)); done; nproc)}
+CAPACITIES=${CAPACITIES:-"16 65536"}
+MIXES=${MIXES:-"90:5:5 50:25:25"}
+VARIANTS=${VARIANTS:-"coarse_grained striped refinable lock_free flat_striped cuckoo striped_rw refinable_rw striped_spin refinable_spin"}
+WORKLOAD=${WORKLOAD:-uniform}
+KEY_SPACE=${KEY_SPACE:-1000000}
+DURATION_MS=${DURATION_MS:-1000}
+REPETITIONS=${REPETITIONS:-5}
+OUTPUT_DIR=${OUTPUT_DIR:-temp/scaling}
+BASELINE=${BASELINE:-temp/scaling_baseline.csv}
+TOLERANCE_PERCENT=${TOLERANCE_PERCENT:-10}
+UPDATE_BASELINE=${UPDATE_BASELINE:-0}
+
+if [ -z "${BUILD_DIR:-}" ]; then
+  test -d temp/
+  ./scripts/check_build.sh
+  BUILD_DIR=temp/build-release
+fi
+
+mkdir -p "${OUTPUT_DIR}"
+RUNS="${OUTPUT_DIR}/runs.csv"
+SUMMARY="${OUTPUT_DIR}/summary.csv"
+echo "variant,capacity,mix,threads,repetition,operations_per_second" > "${RUNS}"
+
+# Runs one configuration and prints its throughput, from the JSON report. A
+# demo that fails, or reports no throughput, stops the sweep, rather than being
+# recorded as 0 ops/s.
+run() {
+  local throughput
+  if ! throughput=$("${BUILD_DIR}/demo_$1" "$2" "$3" 0 \
+      "--workload=${WORKLOAD}" "--mix=$4" "--key-space=${KEY_SPACE}" \
+      "--duration-ms=${DURATION_MS}" --output=json |
+      sed -n 's/.*"operations_per_second": \([0-9]*\).*/\1/p') ||
+    ! [[ "${throughput}" =~ ^[1-9][0-9]*$ ]]; then
+    echo "demo_$1 $2 $3 $4 failed or reported no throughput" >&2
+    exit 1
+  fi
+  echo "${throughput}"
+}
+
+for variant in ${VARIANTS}; do
+  for capacity in ${CAPACITIES}; do
+    for mix in ${MIXES}; do
+      for threads in ${THREADS}; do
+        run "${variant}" "${threads}" "${capacity}" "${mix}" > /dev/null
+        for repetition in $(seq 1 "${REPETITIONS}"); do
+          throughput=$(run "${variant}" "${threads}" "${capacity}" "${mix}")
+          echo "${variant},${capacity},${mix},${threads},${repetition},${throughput}" >> "${RUNS}"
+        done
+      done
+    done
+  done
+done
+
+# The median of each configuration, and its speedup over the median of the
+# smallest thread count of the same variant, capacity and mix.
+awk -F, '
+  NR == 1 { next }
+  {
+    key = $1 "," $2 "," $3 "," $4
+    if (!(key in count)) {
+      keys[++key_count] = key
+      group = $1 "," $2 "," $3
+      if (!(group in min_threads) || $4 + 0 < min_threads[group]) {
+        min_threads[group] = $4 + 0
+      }
+    }
+    values[key, ++count[key]] = $6 + 0
+  }
+  END {
+    print "variant,capacity,mix,threads,median_operations_per_second,speedup"
+    for (k = 1; k <= key_count; k++) {
+      key = keys[k]
+      n = count[key]
+      for (i = 1; i <= n; i++) {
+        sorted[i] = values[key, i]
+      }
+      for (i = 2; i <= n; i++) {
+        for (j = i; j > 1 && sorted[j - 1] > sorted[j]; j--) {
+          swap = sorted[j]; sorted[j] = sorted[j - 1]; sorted[j - 1] = swap
+        }
+      }
+      median[key] = n % 2 ? sorted[(n + 1) / 2] \
+                          : (sorted[n / 2] + sorted[n / 2 + 1]) / 2
+    }
+    for (k = 1; k <= key_count; k++) {
+      key = keys[k]
+      split(key, fields, ",")
+      base = fields[1] "," fields[2] "," fields[3] "," \
+             min_threads[fields[1] "," fields[2] "," fields[3]]
+      speedup = median[base] > 0 ? median[key] / median[base] : 0
+      printf "%s,%d,%.2f\n", key, median[key], speedup
+    }
+  }' "${RUNS}" > "${SUMMARY}"
+
+awk -F, '
+  NR == 1 { next }
+  {
+    printf "%s\n  {\"variant\": \"%s\", \"capacity\": %s, \"mix\": \"%s\", " \
+           "\"threads\": %s, \"median_operations_per_second\": %s, " \
+           "\"speedup\": %s}", NR == 2 ? "[" : ",", $1, $2, $3, $4, $5, $6
+  }
+  END { print NR < 2 ? "[]" : "\n]" }' "${SUMMARY}" > "${OUTPUT_DIR}/summary.json"
+
+if [ "${UPDATE_BASELINE}" = 1 ]; then
+  cp "${SUMMARY}" "${BASELINE}"
+  exit 0
+fi
+if [ ! -f "${BASELINE}" ]; then
+  echo "No baseline at ${BASELINE}, run with UPDATE_BASELINE=1 to store one"
+  exit 0
+fi
+
+# Lists the configurations whose median dropped by more than the tolerance,
+# and fails if there is any. Configurations missing from either side are
+# skipped, but a baseline without a positive throughput is rejected, since no
+# run can be compared with it.
+awk -F, -v tolerance="${TOLERANCE_PERCENT}" '
+  FNR == 1 { next }
+  NR == FNR {
+    if (!($5 ~ /^[0-9]+$/) || $5 == 0) {
+      printf "Invalid baseline for %s,%s,%s,%s: %s\n", $1, $2, $3, $4, $5
+      invalid = 1
+      exit
+    }
+    baseline[$1 "," $2 "," $3 "," $4] = $5
+    next
+  }
+  {
+    key = $1 "," $2 "," $3 "," $4
+    if (!(key in baseline)) {
+      next
+    }
+    change = ($5 - baseline[key]) * 100 / baseline[key]
+    status = change < -tolerance ? "REGRESSION" : "ok"
+    printf "%-10s %s: %d ops/s, baseline %d ops/s, %+.1f%%\n", status, key,
+           $5, baseline[key], change
+    if (change < -tolerance) {
+      regressions++
+    }
+  }
+  END { exit invalid || regressions > 0 }' "${BASELINE}" "${SUMMARY}"
@@ -0,0 +1,33 @@
+#include "src/allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// The counter is per thread, so that counting does not add contention on a
+// shared cache line to every allocation of the benchmark.
+thread_local size_t allocation_count = 0;
+
+} // namespace
+
+namespace benchmark {
+
+size_t ThreadAllocationCount() { return allocation_count; }
+
+} // namespace benchmark
+
+// The array and nothrow forms of operator new and delete forward to these by
+// default, so replacing the single-object forms is enough to count them all.
+void *operator new(size_t size) {
+  allocation_count++;
+  void *ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t /*size*/) noexcept { std::free(ptr); }
@@ -0,0 +1,15 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace benchmark {
+
+// Returns the number of heap allocations made by the calling thread so far.
+// The count is only maintained in binaries that link allocation_counter.cc,
+// which replaces the global operator new.
+size_t ThreadAllocationCount();
+
+} // namespace benchmark
+
+#endif // ALLOCATION_COUNTER_H
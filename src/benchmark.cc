@@ -2,30 +2,102 @@
 
 namespace benchmark {
 
-void ThreadBody(HashSetBase<int> &hash_set, size_t chunk_size, size_t id,
-                size_t &max_observed_size) {
-  max_observed_size = 0;
-  for (size_t k = 0; k < chunk_size * 2; k++) {
-    int elem = static_cast<int>(id * chunk_size + k);
-    hash_set.Add(elem);
-    max_observed_size = std::max(max_observed_size, hash_set.Size());
-  }
-  for (size_t j = 0; j < 20; j++) {
-    for (size_t k = 0; k < chunk_size * 2; k++) {
-      int elem = static_cast<int>(id * chunk_size + k);
-      if (hash_set.Contains(elem)) {
-        if ((elem % 20) == 0) {
-          hash_set.Remove(elem);
-          max_observed_size = std::max(max_observed_size, hash_set.Size());
-        }
+namespace {
+
+// Parses one of the resize policy options into |options|. Returns false if
+// |option| is none of them or is malformed.
+bool ParseResizePolicyOption(const std::string &option,
+                             ResizePolicyOptions &options) {
+  size_t equals = option.find('=');
+  if (equals == std::string::npos) {
+    return false;
+  }
+  std::string name = option.substr(0, equals);
+  std::string value = option.substr(equals + 1);
+  if (name == "--max-load-factor") {
+    return ParseSize(value, options.max_load_factor) &&
+           options.max_load_factor != 0;
+  }
+  if (name == "--min-load-factor") {
+    return ParseSize(value, options.min_load_factor);
+  }
+  if (name == "--growth-factor") {
+    return ParseSize(value, options.growth_factor);
+  }
+  if (name == "--max-lock-count") {
+    return ParseSize(value, options.max_lock_count) &&
+           options.max_lock_count != 0;
+  }
+  return false;
+}
+
+} // namespace
+
+void PrintUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " num_threads initial_capacity chunk_size"
+            << " [--batched] [--count-allocations] [--incremental-resize]"
+            << " [--workload=uniform|zipfian|sequential|hot-set]"
+            << " [--mix=read:insert:delete] [--key-space=keys]"
+            << " [--duration-ms=ms] [--latency] [--output=text|json|csv]"
+            << " [--max-load-factor=n] [--min-load-factor=n]"
+            << " [--growth-factor=n] [--max-lock-count=n] [--virtual]"
+            << " [--pin=cores|nodes]"
+            << std::endl;
+}
+
+bool ParseBenchmarkOptions(int argc, char **argv, BenchmarkOptions &options) {
+  if (argc < 4) {
+    PrintUsage(argv[0]);
+    return false;
+  }
+  for (int i = 4; i < argc; i++) {
+    std::string option(argv[i]);
+    if (option == "--batched") {
+      options.batched = true;
+    } else if (option == "--count-allocations") {
+      options.count_allocations = true;
+    } else if (option == "--incremental-resize") {
+      options.incremental_resize = true;
+    } else if (ParseWorkloadOption(option, options.workload)) {
+      options.run_workload = true;
+    } else if (ParseResizePolicyOption(option, options.resize_policy)) {
+      options.resize_policy.given = true;
+    } else if (option == "--latency") {
+      options.record_latencies = true;
+    } else if (option == "--virtual") {
+      options.virtual_dispatch = true;
+    } else if (option == "--pin=cores") {
+      options.pinning = ThreadPinning::kCores;
+    } else if (option == "--pin=nodes") {
+      options.pinning = ThreadPinning::kNodes;
+    } else if (option.rfind("--output=", 0) == 0) {
+      if (!ParseOutputFormat(option.substr(9), options.output)) {
+        PrintUsage(argv[0]);
+        return false;
       }
+    } else {
+      PrintUsage(argv[0]);
+      return false;
     }
   }
-  for (size_t k = 0; k < chunk_size * 2; k++) {
-    int elem = static_cast<int>(id * chunk_size + k);
-    hash_set.Add(elem);
-    max_observed_size = std::max(max_observed_size, hash_set.Size());
+  if (!ResizePolicy::IsValid(options.resize_policy.max_load_factor,
+                             options.resize_policy.min_load_factor,
+                             options.resize_policy.growth_factor)) {
+    std::cerr << argv[0] << " needs a growth factor of at least 2, and a min"
+              << " load factor times the growth factor of at most the max"
+              << " load factor" << std::endl;
+    return false;
+  }
+  if (options.run_workload && options.batched) {
+    std::cerr << argv[0] << " does not support --batched with a workload"
+              << std::endl;
+    return false;
   }
+  options.num_threads = std::stoul(std::string(argv[1]));
+  options.initial_capacity = std::stoul(std::string(argv[2]));
+  options.chunk_size = std::stoul(std::string(argv[3]));
+  return true;
 }
 
 } // namespace benchmark
@@ -5,26 +5,239 @@
 #include <chrono>
 #include <cstddef>
 #include <iostream>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
-#include "src/hash_set_base.h"
+#include "src/allocation_counter.h"
+#include "src/hash_set_interface.h"
+#include "src/hash_set_stats.h"
+#include "src/latency_histogram.h"
+#include "src/numa_topology.h"
+#include "src/report.h"
+#include "src/resize_mode.h"
+#include "src/resize_policy.h"
+#include "src/workload.h"
 
+/*
+ * The demos run the benchmark below on one hash set type each. Everything is
+ * templated on the hash set type, so that the operations are called directly
+ * and can be inlined, as they would be in code using the hash set. With
+ * --virtual the same benchmark runs through a HashSetAdapter instead, which
+ * measures the cost of calling the operations through virtual functions.
+ */
 namespace benchmark {
 
-void ThreadBody(HashSetBase<int> &hash_set, size_t chunk_size, size_t id,
-                size_t &max_observed_size);
+// Records the latency of each operation in |latencies| unless it is null.
+template <typename HashSetType>
+void ThreadBody(HashSetType &hash_set, size_t chunk_size, size_t id,
+                size_t &max_observed_size, OperationLatencies *latencies) {
+  LatencyHistogram *add = HistogramOf(latencies, &OperationLatencies::add);
+  LatencyHistogram *remove =
+      HistogramOf(latencies, &OperationLatencies::remove);
+  LatencyHistogram *contains =
+      HistogramOf(latencies, &OperationLatencies::contains);
+  max_observed_size = 0;
+  for (size_t k = 0; k < chunk_size * 2; k++) {
+    int elem = static_cast<int>(id * chunk_size + k);
+    Timed(add, [&] { return hash_set.Add(elem); });
+    max_observed_size = std::max(max_observed_size, hash_set.Size());
+  }
+  for (size_t j = 0; j < 20; j++) {
+    for (size_t k = 0; k < chunk_size * 2; k++) {
+      int elem = static_cast<int>(id * chunk_size + k);
+      if (Timed(contains, [&] { return hash_set.Contains(elem); })) {
+        if ((elem % 20) == 0) {
+          Timed(remove, [&] { return hash_set.Remove(elem); });
+          max_observed_size = std::max(max_observed_size, hash_set.Size());
+        }
+      }
+    }
+  }
+  for (size_t k = 0; k < chunk_size * 2; k++) {
+    int elem = static_cast<int>(id * chunk_size + k);
+    Timed(add, [&] { return hash_set.Add(elem); });
+    max_observed_size = std::max(max_observed_size, hash_set.Size());
+  }
+}
 
-template <typename HashSetType> int RunBenchmark(int argc, char **argv) {
-  if (argc != 4) {
-    std::cerr << "Usage: " << argv[0]
-              << " num_threads initial_capacity chunk_size" << std::endl;
+// Performs the same operations as ThreadBody, but through the batch
+// operations, with one batch per pass over the elements of the thread. The
+// latencies it records are those of whole batches.
+template <typename HashSetType>
+void BatchedThreadBody(HashSetType &hash_set, size_t chunk_size, size_t id,
+                       size_t &max_observed_size,
+                       OperationLatencies *latencies) {
+  LatencyHistogram *add = HistogramOf(latencies, &OperationLatencies::add);
+  LatencyHistogram *remove =
+      HistogramOf(latencies, &OperationLatencies::remove);
+  LatencyHistogram *contains =
+      HistogramOf(latencies, &OperationLatencies::contains);
+  std::vector<int> elems;
+  elems.reserve(chunk_size * 2);
+  for (size_t k = 0; k < chunk_size * 2; k++) {
+    elems.push_back(static_cast<int>(id * chunk_size + k));
+  }
+  Timed(add, [&] { return hash_set.AddAll(elems); });
+  max_observed_size = hash_set.Size();
+  for (size_t j = 0; j < 20; j++) {
+    std::vector<bool> present =
+        Timed(contains, [&] { return hash_set.ContainsMany(elems); });
+    std::vector<int> to_remove;
+    for (size_t k = 0; k < elems.size(); k++) {
+      if (present[k] && (elems[k] % 20) == 0) {
+        to_remove.push_back(elems[k]);
+      }
+    }
+    Timed(remove, [&] { return hash_set.RemoveAll(to_remove); });
+    max_observed_size = std::max(max_observed_size, hash_set.Size());
+  }
+  Timed(add, [&] { return hash_set.AddAll(elems); });
+  max_observed_size = std::max(max_observed_size, hash_set.Size());
+}
+
+void PrintUsage(const char *program);
+
+// The factors given by the --max-load-factor=, --min-load-factor= and
+// --growth-factor= options, and the lock cap of --max-lock-count=. The
+// factors are only checked once all the options are parsed, since only some
+// combinations of them make a valid ResizePolicy.
+struct ResizePolicyOptions {
+  size_t max_load_factor = ResizePolicy().MaxLoadFactor();
+  size_t min_load_factor = ResizePolicy().MinLoadFactor();
+  size_t growth_factor = ResizePolicy().GrowthFactor();
+  size_t max_lock_count = ResizePolicy().MaxLockCount();
+  bool given = false;
+};
+
+// The command line of a demo, see RunBenchmark.
+struct BenchmarkOptions {
+  size_t num_threads = 0;
+  size_t initial_capacity = 0;
+  size_t chunk_size = 0;
+  bool batched = false;
+  bool count_allocations = false;
+  bool incremental_resize = false;
+  bool run_workload = false;
+  bool record_latencies = false;
+  bool virtual_dispatch = false;
+  ThreadPinning pinning = ThreadPinning::kNone;
+  OutputFormat output = OutputFormat::kText;
+  WorkloadConfig workload;
+  ResizePolicyOptions resize_policy;
+};
+
+// Parses the command line of a demo into |options|. Returns false, after
+// printing the usage or what is wrong with the options, if it is malformed or
+// combines options that do not go together.
+bool ParseBenchmarkOptions(int argc, char **argv, BenchmarkOptions &options);
+
+// Checks that Contains does not allocate, looking up the keys [0, key_count)
+// of a hash set in a steady state, which catches lookups that copy a bucket
+// instead of scanning it in place. Returns false and reports the allocations
+// otherwise.
+template <typename HashSetType>
+bool CheckContainsDoesNotAllocate(const char *program, HashSetType &hash_set,
+                                  size_t key_count) {
+  size_t allocations_before = ThreadAllocationCount();
+  for (size_t i = 0; i < key_count; i++) {
+    (void)hash_set.Contains(static_cast<int>(i));
+  }
+  size_t allocations = ThreadAllocationCount() - allocations_before;
+  if (allocations != 0) {
+    std::cerr << program << " failed: " << allocations
+              << " heap allocations in " << key_count << " calls to Contains"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Runs |config| on |num_threads| threads, checks the size of the hash set
+// afterwards and reports the throughput. Returns the exit code of the demo.
+template <typename HashSetType>
+int RunWorkloadBenchmark(const char *program, HashSetType &hash_set,
+                         size_t num_threads, const WorkloadConfig &config,
+                         bool count_allocations, bool record_latencies,
+                         ThreadPinning pinning, OutputFormat output) {
+  OperationLatencies latencies;
+  WorkloadResult result =
+      RunWorkload(hash_set, num_threads, config,
+                  record_latencies ? &latencies : nullptr, pinning);
+#ifdef HASH_SET_STATS
+  HashSetStats stats = hash_set.Stats();
+#endif
+  if (hash_set.Size() != result.expected_size) {
+    std::cerr << program << " failed: size " << hash_set.Size()
+              << " does not match expected size " << result.expected_size
+              << std::endl;
+    return 1;
+  }
+  // The workload has already warmed the hash set up.
+  if (count_allocations &&
+      !CheckContainsDoesNotAllocate(program, hash_set, config.key_space)) {
     return 1;
   }
-  size_t num_threads = std::stoul(std::string(argv[1]));
-  size_t initial_capacity = std::stoul(std::string(argv[2]));
-  size_t chunk_size = std::stoul(std::string(argv[3]));
 
-  HashSetType hash_set(initial_capacity);
+  Report report;
+  report.program = program;
+  report.description = WorkloadDescription(config);
+  report.millis = result.elapsed.count();
+  report.operations = result.operations;
+  report.latencies = record_latencies ? &latencies : nullptr;
+#ifdef HASH_SET_STATS
+  report.stats = &stats;
+#endif
+  PrintReport(report, output, std::cout);
+  return 0;
+}
+
+template <typename HashSetType>
+constexpr bool kSupportsResizePolicy =
+    std::is_constructible_v<HashSetType, size_t, ResizeMode, ResizePolicy> ||
+    std::is_constructible_v<HashSetType, size_t, ResizePolicy>;
+
+// Constructs the hash set, in the incremental resize mode if requested and
+// with |resize_policy|, as far as |HashSetType| supports them.
+template <typename HashSetType>
+HashSetType MakeHashSet(size_t initial_capacity, bool incremental_resize,
+                        const ResizePolicy &resize_policy) {
+  ResizeMode resize_mode = incremental_resize ? ResizeMode::kIncremental
+                                              : ResizeMode::kStopTheWorld;
+  if constexpr (std::is_constructible_v<HashSetType, size_t, ResizeMode,
+                                        ResizePolicy>) {
+    return HashSetType(initial_capacity, resize_mode, resize_policy);
+  } else if constexpr (std::is_constructible_v<HashSetType, size_t,
+                                               ResizeMode>) {
+    return HashSetType(initial_capacity, resize_mode);
+  } else if constexpr (std::is_constructible_v<HashSetType, size_t,
+                                               ResizePolicy>) {
+    return HashSetType(initial_capacity, resize_policy);
+  } else {
+    (void)resize_mode;
+    (void)resize_policy;
+    return HashSetType(initial_capacity);
+  }
+}
+
+// Runs the benchmark of |options| on |hash_set|. Returns the exit code of the
+// demo.
+template <typename HashSetType>
+int RunBenchmarkOn(const char *program, HashSetType &hash_set,
+                   const BenchmarkOptions &options) {
+  size_t num_threads = options.num_threads;
+  size_t chunk_size = options.chunk_size;
+  bool record_latencies = options.record_latencies;
+  if (options.run_workload) {
+    WorkloadConfig workload = options.workload;
+    if (workload.key_space == 0) {
+      workload.key_space = chunk_size * (num_threads + 1);
+    }
+    return RunWorkloadBenchmark(program, hash_set, num_threads, workload,
+                                options.count_allocations, record_latencies,
+                                options.pinning, options.output);
+  }
 
   std::vector<size_t> max_observed_sizes;
   max_observed_sizes.reserve(num_threads);
@@ -32,44 +245,120 @@ template <typename HashSetType> int RunBenchmark(int argc, char **argv) {
     max_observed_sizes.emplace_back(0u);
   }
 
+  // Each thread records into a histogram of its own, merged at the end.
+  std::vector<OperationLatencies> thread_latencies(
+      record_latencies ? num_threads : 0);
+
   std::vector<std::thread> threads;
   threads.reserve(num_threads);
 
   auto begin_time = std::chrono::high_resolution_clock::now();
   for (size_t i = 0; i < num_threads; i++) {
-    threads.emplace_back(std::thread(ThreadBody, std::ref(hash_set), chunk_size,
-                                     i, std::ref(max_observed_sizes.at(i))));
+    auto body = options.batched ? BatchedThreadBody<HashSetType>
+                                : ThreadBody<HashSetType>;
+    OperationLatencies *latencies_of_thread =
+        record_latencies ? &thread_latencies[i] : nullptr;
+    threads.emplace_back([&, body, i, latencies_of_thread] {
+      PinThread(options.pinning, i);
+      body(hash_set, chunk_size, i, max_observed_sizes.at(i),
+           latencies_of_thread);
+    });
   }
   for (auto &thread : threads) {
     thread.join();
   }
   auto end_time = std::chrono::high_resolution_clock::now();
 
+#ifdef HASH_SET_STATS
+  // The stats are read before the checks below add lookups of their own.
+  HashSetStats stats = hash_set.Stats();
+#endif
+
   auto duration = end_time - begin_time;
   auto millis =
       std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
 
   size_t expected_size = chunk_size * (num_threads + 1);
   if (hash_set.Size() != expected_size) {
-    std::cerr << argv[0] << " failed: size " << hash_set.Size()
+    std::cerr << program << " failed: size " << hash_set.Size()
               << " does not match expected size " << expected_size << std::endl;
     return 1;
   }
   for (size_t i = 0; i < chunk_size * (num_threads + 1); i++) {
     int expected_value = static_cast<int>(i);
     if (!hash_set.Contains(expected_value)) {
-      std::cerr << argv[0] << " failed: expected value " << expected_value
+      std::cerr << program << " failed: expected value " << expected_value
                 << " not found" << std::endl;
       return 1;
     }
   }
+  // The pass above has warmed the hash set up, e.g. initialised any lazily
+  // created buckets, so this pass only measures the steady state.
+  if (options.count_allocations &&
+      !CheckContainsDoesNotAllocate(program, hash_set, expected_size)) {
+    return 1;
+  }
 
-  std::cout << argv[0] << " succeeded" << std::endl;
-  std::cout << "Concurrent computation took:" << std::endl;
-  std::cout << "  " << millis << " ms" << std::endl;
+  OperationLatencies latencies;
+  for (const OperationLatencies &latencies_of_thread : thread_latencies) {
+    latencies.Merge(latencies_of_thread);
+  }
+  Report report;
+  report.program = program;
+  report.millis = millis;
+  report.latencies = record_latencies ? &latencies : nullptr;
+#ifdef HASH_SET_STATS
+  report.stats = &stats;
+#endif
+  PrintReport(report, options.output, std::cout);
   return 0;
 }
 
+// Runs ThreadBody on |num_threads| threads and checks the contents of the
+// hash set afterwards. With --batched, the threads run BatchedThreadBody
+// instead. With --count-allocations, it also checks that Contains does not
+// allocate once the hash set is in a steady state. Any of the --workload=,
+// --mix=, --key-space= and --duration-ms= options runs a timed operation mix
+// instead of ThreadBody, over chunk_size * (num_threads + 1) keys unless
+// --key-space= says otherwise. With --latency, the latency of each operation
+// is recorded and percentiles are reported per operation type, and
+// --output=json or --output=csv prints a machine readable report instead. The
+// --max-load-factor=, --min-load-factor= and --growth-factor= options
+// configure the resize policy of the hash sets that take one, --virtual calls
+// the hash set through HashSetInterface, and --pin=cores or --pin=nodes pins
+// the threads to one CPU each or to the CPUs of one NUMA node each, in turn.
+template <typename HashSetType> int RunBenchmark(int argc, char **argv) {
+  BenchmarkOptions options;
+  if (!ParseBenchmarkOptions(argc, argv, options)) {
+    return 1;
+  }
+  if (options.incremental_resize &&
+      !std::is_constructible_v<HashSetType, size_t, ResizeMode>) {
+    std::cerr << argv[0] << " does not support --incremental-resize"
+              << std::endl;
+    return 1;
+  }
+  if (options.resize_policy.given && !kSupportsResizePolicy<HashSetType>) {
+    std::cerr << argv[0] << " does not support a resize policy" << std::endl;
+    return 1;
+  }
+  ResizePolicy resize_policy(options.resize_policy.max_load_factor,
+                             options.resize_policy.min_load_factor,
+                             options.resize_policy.growth_factor,
+                             options.resize_policy.max_lock_count);
+
+  if (options.virtual_dispatch) {
+    HashSetAdapter<HashSetType> hash_set =
+        MakeHashSet<HashSetAdapter<HashSetType>>(options.initial_capacity,
+                                                 options.incremental_resize,
+                                                 resize_policy);
+    return RunBenchmarkOn<HashSetInterface<int>>(argv[0], hash_set, options);
+  }
+  HashSetType hash_set = MakeHashSet<HashSetType>(
+      options.initial_capacity, options.incremental_resize, resize_policy);
+  return RunBenchmarkOn(argv[0], hash_set, options);
+}
+
 } // namespace benchmark
 
 #endif // BENCHMARK_H
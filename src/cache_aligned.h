@@ -0,0 +1,35 @@
+#ifndef CACHE_ALIGNED_H
+#define CACHE_ALIGNED_H
+
+#include <cstddef>
+#include <new>
+
+// The alignment that keeps two objects from sharing a cache line. It can be
+// overridden with -DHASH_SET_CACHE_LINE_SIZE=<bytes>, and otherwise comes from
+// std::hardware_destructive_interference_size where the standard library
+// provides it.
+#if defined(HASH_SET_CACHE_LINE_SIZE)
+constexpr size_t kCacheLineSize = HASH_SET_CACHE_LINE_SIZE;
+#elif defined(__cpp_lib_hardware_interference_size)
+constexpr size_t kCacheLineSize = std::hardware_destructive_interference_size;
+#else
+constexpr size_t kCacheLineSize = 64;
+#endif
+
+// The alignment that keeps an object of |size| bytes, naturally aligned to
+// |align|, from straddling a cache line boundary it could fit within: the
+// smallest power of two from |align| that is at least |size|, up to a cache
+// line.
+constexpr size_t CacheFriendlyAlignment(size_t size, size_t align) {
+  while (align < size && align < kCacheLineSize) {
+    align *= 2;
+  }
+  return align;
+}
+
+// A |Mutex| that occupies a cache line of its own, so that threads locking
+// neighbouring mutexes in a vector do not invalidate each other's cache line.
+template <typename Mutex>
+class alignas(kCacheLineSize) CacheAligned : public Mutex {};
+
+#endif // CACHE_ALIGNED_H
@@ -1,4 +1,8 @@
 #include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_flat.h"
+#include "src/hash_set_flat_striped.h"
+#include "src/hash_set_lock_free.h"
 #include "src/hash_set_refinable.h"
 #include "src/hash_set_sequential.h"
 #include "src/hash_set_striped.h"
@@ -16,6 +20,38 @@ void Placeholder() {
     (void)hs.Contains(1);
   }
 
+  {
+    HashSetCuckoo<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetFlat<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetFlatStriped<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetLockFree<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
   {
     HashSetRefinable<int> hs(16);
     hs.Add(1);
@@ -10,6 +10,10 @@ void Placeholder() {
   hs.Remove(1);
   (void)hs.Size();
   (void)hs.Contains(1);
+  hs.Reserve(64);
+
+  HashSetCoarseGrained<int> bulk({1, 2, 2}, 16);
+  (void)bulk.Contains(2);
 }
 
 } // namespace check_coarse_grained
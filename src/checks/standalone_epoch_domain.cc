@@ -0,0 +1,20 @@
+#include <atomic>
+
+#include "src/epoch_domain.h"
+
+namespace check_epoch_domain {
+
+void Placeholder();
+
+void Placeholder() {
+  EpochDomain domain;
+  std::atomic<int *> value(new int(1));
+  {
+    EpochDomain::Guard guard(domain);
+    (void)*value.load();
+  }
+  domain.Retire(value.exchange(new int(2)));
+  delete value.load();
+}
+
+} // namespace check_epoch_domain
@@ -0,0 +1,19 @@
+#include "src/hash_set_flat_striped.h"
+
+namespace check_flat_striped {
+
+void Placeholder();
+
+void Placeholder() {
+  HashSetFlatStriped<int> hs(16);
+  hs.Add(1);
+  hs.Remove(1);
+  (void)hs.Size();
+  (void)hs.Contains(1);
+  hs.Reserve(64);
+
+  HashSetFlatStriped<int> bulk({1, 2, 2}, 16);
+  (void)bulk.Contains(2);
+}
+
+} // namespace check_flat_striped
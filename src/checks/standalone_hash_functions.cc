@@ -0,0 +1,30 @@
+#include "src/hash_functions.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_striped.h"
+
+namespace check_hash_functions {
+
+void Placeholder();
+
+void Placeholder() {
+  (void)BucketIndex(MixHash(1), 16);
+  (void)BucketIndex(MixHash(1), 12);
+
+  {
+    HashSetStriped<int, FastHash<int>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetLockFree<int, FastHash<int>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+}
+
+} // namespace check_hash_functions
@@ -0,0 +1,52 @@
+#include <type_traits>
+
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_flat.h"
+#include "src/hash_set_flat_striped.h"
+#include "src/hash_set_interface.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+
+namespace check_interface {
+
+// The hash sets themselves have no virtual functions.
+static_assert(!std::is_polymorphic_v<HashSetCoarseGrained<int>>);
+static_assert(!std::is_polymorphic_v<HashSetCuckoo<int>>);
+static_assert(!std::is_polymorphic_v<HashSetFlat<int>>);
+static_assert(!std::is_polymorphic_v<HashSetFlatStriped<int>>);
+static_assert(!std::is_polymorphic_v<HashSetLockFree<int>>);
+static_assert(!std::is_polymorphic_v<HashSetRefinable<int>>);
+static_assert(!std::is_polymorphic_v<HashSetSequential<int>>);
+static_assert(!std::is_polymorphic_v<HashSetStriped<int>>);
+
+static_assert(
+    std::is_constructible_v<HashSetAdapter<HashSetStriped<int>>, size_t,
+                            ResizeMode>);
+static_assert(
+    !std::is_constructible_v<HashSetAdapter<HashSetFlat<int>>, size_t,
+                             ResizeMode>);
+
+void Placeholder();
+
+void Placeholder() {
+  HashSetAdapter<HashSetStriped<int>> striped(16u, ResizeMode::kIncremental);
+  HashSetAdapter<HashSetLockFree<int>> lock_free(16u);
+  for (HashSetInterface<int> *hs :
+       {static_cast<HashSetInterface<int> *>(&striped),
+        static_cast<HashSetInterface<int> *>(&lock_free)}) {
+    hs->Add(1);
+    hs->Remove(1);
+    (void)hs->Size();
+    (void)hs->Contains(1);
+    hs->AddAll({1, 2});
+    (void)hs->ContainsMany({1, 2});
+    hs->RemoveAll({1, 2});
+    hs->Reserve(64);
+  }
+  (void)striped.Get().Size();
+}
+
+} // namespace check_interface
@@ -0,0 +1,19 @@
+#include "src/hash_set_lock_free.h"
+
+namespace check_lock_free {
+
+void Placeholder();
+
+void Placeholder() {
+  HashSetLockFree<int> hs(16);
+  hs.Add(1);
+  hs.Remove(1);
+  (void)hs.Size();
+  (void)hs.Contains(1);
+  hs.Reserve(64);
+
+  HashSetLockFree<int> bulk({1, 2, 2}, 16);
+  (void)bulk.Contains(2);
+}
+
+} // namespace check_lock_free
@@ -0,0 +1,40 @@
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "src/hash_functions.h"
+#include "src/hash_map_striped.h"
+
+namespace check_map_striped {
+
+void Placeholder();
+
+void Placeholder() {
+  HashMapStriped<int, int> hm(16);
+  hm.InsertOrAssign(1, 10);
+  hm.InsertOrAssign(1, 11);
+  (void)hm.Find(1);
+  (void)hm.Contains(1);
+  hm.Upsert(2, 1, [](int &value) { value++; });
+  hm.Compute(2, [](std::optional<int> &value) {
+    if (value.has_value()) {
+      value.reset();
+    }
+  });
+  hm.Remove(1);
+  (void)hm.Size();
+  hm.Reserve(64);
+  hm.ForEach([](int key, int value) {
+    (void)key;
+    (void)value;
+  });
+
+  HashMapStriped<std::string, size_t, StringHash> strings(16);
+  strings.InsertOrAssign("key", 1);
+  (void)strings.Find(std::string_view("key"));
+  (void)strings.Contains("key");
+  strings.Remove(std::string_view("key"));
+}
+
+} // namespace check_map_striped
@@ -0,0 +1,38 @@
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "src/cache_aligned.h"
+#include "src/hash_set_numa.h"
+#include "src/hash_set_striped.h"
+#include "src/node_memory.h"
+#include "src/numa_topology.h"
+
+namespace check_numa {
+
+void Placeholder();
+
+void Placeholder() {
+  (void)NumaTopology::Get().NodeCount();
+  (void)CurrentNode();
+  PinThread(ThreadPinning::kNone, 0);
+
+  HashSetNuma<HashSetStriped<int>> hs(16u, ResizeMode::kIncremental);
+  hs.Add(1);
+  hs.Remove(1);
+  (void)hs.Size();
+  (void)hs.Contains(1);
+  hs.AddAll({1, 2});
+  hs.Reserve(64);
+
+  HashSetNuma<HashSetStriped<int>> bulk(std::vector<int>{1, 2, 2}, 16u);
+  (void)bulk.Contains(2);
+
+  HashSetNuma<HashSetStriped<int, std::hash<int>, CacheAligned<std::mutex>,
+                             NodeAllocator<int>>>
+      node_bound(16u, ResizeMode::kStopTheWorld);
+  node_bound.AddAll({1, 2});
+  (void)node_bound.Contains(2);
+}
+
+} // namespace check_numa
@@ -0,0 +1,20 @@
+#include <atomic>
+#include <cstddef>
+
+#include "src/parallel_for.h"
+
+namespace check_parallel_for {
+
+void Placeholder();
+
+void Placeholder() {
+  std::atomic<size_t> sum(0);
+  ParallelFor(100, ThreadCountFor(100, 10), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      sum += i;
+    }
+  });
+  (void)sum.load();
+}
+
+} // namespace check_parallel_for
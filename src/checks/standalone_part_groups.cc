@@ -0,0 +1,21 @@
+#include <cstddef>
+#include <vector>
+
+#include "src/part_groups.h"
+
+namespace check_part_groups {
+
+void Placeholder();
+
+void Placeholder() {
+  std::vector<size_t> indices = {0, 1, 2, 3};
+  PartGroups groups(indices, 2, [](size_t i) { return i % 2; });
+  PartGroups::Group group =
+      groups.Of(FirstGroupOfThread(groups.GroupCount()));
+  PartGroups sparse(group, 16, [](size_t i) { return i; });
+  for (size_t i : sparse.Of(0)) {
+    (void)i;
+  }
+}
+
+} // namespace check_part_groups
@@ -0,0 +1,40 @@
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+
+#include "src/cache_aligned.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_striped.h"
+#include "src/reader_lock.h"
+
+namespace check_reader_lock {
+
+static_assert(IsSharedMutex<std::shared_mutex>::value);
+static_assert(IsSharedMutex<CacheAligned<std::shared_mutex>>::value);
+static_assert(!IsSharedMutex<std::mutex>::value);
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::shared_mutex>> hs(
+        16, ResizeMode::kIncremental);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    (void)hs.ContainsMany({1, 2});
+  }
+
+  {
+    HashSetRefinable<int, std::hash<int>, CacheAligned<std::shared_mutex>> hs(
+        16, ResizeMode::kIncremental);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    (void)hs.ContainsMany({1, 2});
+  }
+}
+
+} // namespace check_reader_lock
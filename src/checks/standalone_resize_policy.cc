@@ -0,0 +1,43 @@
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+#include "src/resize_policy.h"
+
+namespace check_resize_policy {
+
+void Placeholder();
+
+void Placeholder() {
+  ResizePolicy policy(8, 2, 4, 64);
+  (void)policy.TargetBucketCount(100, 16, 16);
+  (void)policy.TargetLockCount(256, 16);
+
+  {
+    HashSetSequential<int> hs(16, policy);
+    hs.Add(1);
+    hs.Remove(1);
+  }
+
+  {
+    HashSetCoarseGrained<int> hs(16, policy);
+    hs.Add(1);
+    hs.RemoveAll({1, 2});
+  }
+
+  {
+    HashSetStriped<int> hs(16, ResizeMode::kIncremental, policy);
+    hs.Add(1);
+    hs.Remove(1);
+    hs.RemoveAll({1, 2});
+  }
+
+  {
+    HashSetRefinable<int> hs(16, ResizeMode::kIncremental, policy);
+    hs.Add(1);
+    hs.Remove(1);
+    hs.RemoveAll({1, 2});
+  }
+}
+
+} // namespace check_resize_policy
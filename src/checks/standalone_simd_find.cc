@@ -0,0 +1,24 @@
+#include <cstdint>
+#include <string>
+
+#include "src/simd_find.h"
+
+namespace check_simd_find {
+
+static_assert(kSimdFindable<int>);
+static_assert(kSimdFindable<uint64_t>);
+static_assert(!kSimdFindable<bool>);
+static_assert(!kSimdFindable<std::string>);
+
+void Placeholder();
+
+void Placeholder() {
+  int ints[4] = {1, 2, 3, 4};
+  (void)FindIndex(ints, 3, 4, 4);
+  int64_t longs[4] = {1, 2, 0, 0};
+  (void)FindIndex(longs, 2, int64_t{2}, 4);
+  std::string strings[2] = {"a", "b"};
+  (void)FindIndex(strings, 2, std::string("b"), 2);
+}
+
+} // namespace check_simd_find
@@ -0,0 +1,53 @@
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "src/cache_aligned.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+#include "src/slab_allocator.h"
+
+namespace check_slab_allocator {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    SlabAllocator<int> allocator;
+    std::vector<int, SlabAllocator<int>> elems(allocator);
+    elems.push_back(1);
+    std::vector<int, SlabAllocator<int>> copy(elems);
+    (void)(copy.get_allocator() == allocator);
+  }
+
+  {
+    SlabPool<> pool;
+    pool.Deallocate(pool.Allocate(64 * 1024, 16), 64 * 1024, 16);
+  }
+
+  {
+    HashSetSequential<int, std::hash<int>, SlabAllocator<int>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetCoarseGrained<int, std::hash<int>, SlabAllocator<int>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::mutex>,
+                   SlabAllocator<int>>
+        hs(16, ResizeMode::kIncremental);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+}
+
+} // namespace check_slab_allocator
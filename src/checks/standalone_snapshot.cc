@@ -0,0 +1,39 @@
+#include <memory>
+#include <utility>
+
+#include "src/hash_set_mapped.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_striped.h"
+#include "src/snapshot_image.h"
+
+namespace check_snapshot {
+
+void Placeholder();
+
+void Placeholder() {
+  HashSetStriped<int> striped(16);
+  striped.Add(1);
+  (void)WriteSnapshot("striped.snapshot", striped.Snapshot());
+
+  HashSetRefinable<int> refinable(16);
+  refinable.Add(1);
+  (void)WriteSnapshot("refinable.snapshot", refinable.Snapshot());
+
+  std::unique_ptr<const SnapshotImage<int>> image =
+      SnapshotImage<int>::Map("striped.snapshot");
+  if (image == nullptr) {
+    return;
+  }
+  (void)image->Contains(1);
+  (void)image->Size();
+
+  HashSetMapped<HashSetStriped<int>> hs(std::move(image), 16u);
+  (void)hs.Contains(1);
+  (void)hs.IsPromoted();
+  hs.Add(2);
+  hs.Remove(2);
+  (void)hs.Size();
+  hs.Reserve(64);
+}
+
+} // namespace check_snapshot
@@ -0,0 +1,33 @@
+#include <functional>
+#include <mutex>
+
+#include "src/cache_aligned.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_striped.h"
+#include "src/spin_lock.h"
+
+namespace check_spin_lock {
+
+void Placeholder();
+
+void Placeholder() {
+  SpinLock lock;
+  {
+    std::scoped_lock<SpinLock> guard(lock);
+  }
+  if (lock.try_lock()) {
+    lock.unlock();
+  }
+
+  HashSetStriped<int, std::hash<int>, CacheAligned<SpinLock>> striped(16);
+  striped.Add(1);
+  (void)striped.Contains(1);
+  striped.Remove(1);
+
+  HashSetRefinable<int, std::hash<int>, CacheAligned<SpinLock>> refinable(16);
+  refinable.Add(1);
+  (void)refinable.Contains(1);
+  refinable.Remove(1);
+}
+
+} // namespace check_spin_lock
@@ -0,0 +1,43 @@
+#include <shared_mutex>
+
+#include "src/cache_aligned.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_stats.h"
+#include "src/hash_set_striped.h"
+
+namespace check_stats {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::shared_mutex>> hs(
+        16, ResizeMode::kIncremental);
+    hs.Add(1);
+    (void)hs.Contains(1);
+#ifdef HASH_SET_STATS
+    (void)hs.Stats();
+#endif
+  }
+
+  {
+    HashSetRefinable<int> hs(16, ResizeMode::kIncremental);
+    hs.Add(1);
+    (void)hs.Contains(1);
+#ifdef HASH_SET_STATS
+    (void)hs.Stats();
+#endif
+  }
+
+  {
+    HashSetCoarseGrained<int> hs(16);
+    hs.Add(1);
+    (void)hs.Contains(1);
+#ifdef HASH_SET_STATS
+    (void)hs.Stats();
+#endif
+  }
+}
+
+} // namespace check_stats
@@ -0,0 +1,19 @@
+#include <cstddef>
+
+#include "src/stripe_scan.h"
+
+namespace check_stripe_scan {
+
+void Placeholder();
+
+void Placeholder() {
+  StripeScan scan(8, 4, 0, 2);
+  while (!scan.Done()) {
+    size_t lock = scan.Next() % 4;
+    (void)scan.VisitsWholeLock(lock, 4);
+    (void)scan.Visits(lock);
+    scan.MarkVisited(lock, 4);
+  }
+}
+
+} // namespace check_stripe_scan
@@ -1,3 +1,8 @@
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "src/hash_functions.h"
 #include "src/hash_set_striped.h"
 
 namespace check_striped {
@@ -10,6 +15,24 @@ void Placeholder() {
   hs.Remove(1);
   (void)hs.Size();
   (void)hs.Contains(1);
+  hs.Reserve(64);
+  hs.ForEach([](int elem) { (void)elem; });
+  hs.ParallelForEach(2, [](size_t thread, int elem) {
+    (void)thread;
+    (void)elem;
+  });
+
+  HashSetStriped<int> bulk({1, 2, 2}, 16);
+  (void)bulk.Contains(2);
+
+  HashSetStriped<std::string, StringHash> strings(16);
+  std::string key = "key";
+  strings.Add(key);
+  strings.Add(std::string("moved"));
+  strings.Emplace(size_t{3}, 'a');
+  (void)strings.Contains(std::string_view("aaa"));
+  (void)strings.Contains("key");
+  strings.Remove(std::string_view("moved"));
 }
 
 } // namespace check_striped
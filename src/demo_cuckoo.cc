@@ -0,0 +1,6 @@
+#include "src/benchmark.h"
+#include "src/hash_set_cuckoo.h"
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<HashSetCuckoo<int>>(argc, argv);
+}
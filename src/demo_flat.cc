@@ -0,0 +1,6 @@
+#include "src/hash_set_flat.h"
+#include "src/sequential_demo.h"
+
+int main(int argc, char **argv) {
+  return RunSequentialDemo<HashSetFlat<int>>(argc, argv, "Flat");
+}
@@ -0,0 +1,6 @@
+#include "src/benchmark.h"
+#include "src/hash_set_flat_striped.h"
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<HashSetFlatStriped<int>>(argc, argv);
+}
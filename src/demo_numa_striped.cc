@@ -0,0 +1,19 @@
+#include <functional>
+#include <mutex>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_numa.h"
+#include "src/hash_set_striped.h"
+#include "src/node_memory.h"
+
+// The striped hash set split into one shard per NUMA node, each allocated on
+// its node, including the tables and buckets it allocates as it grows. Run
+// with --pin=nodes to spread the threads over the nodes too.
+using NodeHashSet =
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::mutex>,
+                   NodeAllocator<int>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<HashSetNuma<NodeHashSet>>(argc, argv);
+}
@@ -0,0 +1,16 @@
+#include <functional>
+#include <shared_mutex>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_refinable.h"
+
+// The same hash set as in demo_refinable, but with reader-writer mutexes.
+// Lookups take no locks in either, so this measures what the heavier mutex
+// costs Add and Remove.
+using ReaderWriterHashSet =
+    HashSetRefinable<int, std::hash<int>, CacheAligned<std::shared_mutex>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<ReaderWriterHashSet>(argc, argv);
+}
@@ -0,0 +1,15 @@
+#include <functional>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_refinable.h"
+#include "src/spin_lock.h"
+
+// The same hash set as in demo_refinable, but with spin-then-park bucket
+// mutexes, which only Add and Remove take, since lookups take no lock.
+using SpinLockHashSet =
+    HashSetRefinable<int, std::hash<int>, CacheAligned<SpinLock>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<SpinLockHashSet>(argc, argv);
+}
@@ -0,0 +1,15 @@
+#include <functional>
+#include <shared_mutex>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_striped.h"
+
+// The same hash set as in demo_striped, but with reader-writer mutexes, so that
+// lookups on the same stripe do not serialize.
+using ReaderWriterHashSet =
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::shared_mutex>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<ReaderWriterHashSet>(argc, argv);
+}
@@ -0,0 +1,17 @@
+#include <functional>
+#include <mutex>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_striped.h"
+#include "src/slab_allocator.h"
+
+// The same hash set as in demo_striped, but with the buckets of each stripe
+// allocated from a slab pool of its own instead of malloc.
+using SlabHashSet =
+    HashSetStriped<int, std::hash<int>, CacheAligned<std::mutex>,
+                   SlabAllocator<int>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<SlabHashSet>(argc, argv);
+}
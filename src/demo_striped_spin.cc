@@ -0,0 +1,15 @@
+#include <functional>
+
+#include "src/benchmark.h"
+#include "src/cache_aligned.h"
+#include "src/hash_set_striped.h"
+#include "src/spin_lock.h"
+
+// The same hash set as in demo_striped, but with spin-then-park stripe locks,
+// to compare with std::mutex at each level of contention.
+using SpinLockHashSet =
+    HashSetStriped<int, std::hash<int>, CacheAligned<SpinLock>>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<SpinLockHashSet>(argc, argv);
+}
@@ -0,0 +1,13 @@
+#include <functional>
+#include <mutex>
+
+#include "src/benchmark.h"
+#include "src/hash_set_striped.h"
+
+// The same hash set as in demo_striped, but with densely packed stripe
+// mutexes, to measure the cost of false sharing between them.
+using UnpaddedHashSet = HashSetStriped<int, std::hash<int>, std::mutex>;
+
+int main(int argc, char **argv) {
+  return benchmark::RunBenchmark<UnpaddedHashSet>(argc, argv);
+}
@@ -0,0 +1,171 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "src/cache_aligned.h"
+
+/*
+ * Epoch-based reclamation, which lets readers follow pointers to shared
+ * objects without locks while writers replace those objects. A reader pins
+ * the current epoch for as long as it holds such pointers. A writer first
+ * unlinks an object, so that readers pinned from then on cannot reach it, and
+ * then retires it. The global epoch advances once every pinned reader has
+ * seen the current one, and an object retired in epoch e is freed once the
+ * epoch reaches e + 2, when no reader that could have reached it is left.
+ *
+ * Pinning is a store to a slot of the calling thread, and retiring appends to
+ * a list of the calling thread, so neither takes a lock. The retired objects
+ * are freed by the thread that retired them, every kCollectInterval
+ * retirements, and the rest when the domain is destroyed. Guards do not nest,
+ * and at most kMaxThreads threads may use the domains at a time.
+ */
+class EpochDomain {
+  struct Slot;
+
+public:
+  static constexpr size_t kMaxThreads = 256;
+
+  EpochDomain() : slots_(kMaxThreads) {}
+
+  ~EpochDomain() {
+    for (Slot &slot : slots_) {
+      for (const Retired &retired : slot.retired) {
+        retired.deleter(retired.object);
+      }
+    }
+  }
+
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+
+  // Keeps the objects reachable when it was constructed from being freed
+  // until it is destroyed.
+  class Guard {
+  public:
+    explicit Guard(EpochDomain &domain)
+        : slot_(domain.slots_[ThreadSlot()]) {
+      slot_.pinned.store(domain.epoch_.load());
+    }
+    ~Guard() { slot_.pinned.store(kUnpinned, std::memory_order_release); }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    Slot &slot_;
+  };
+
+  // Frees |object| once no reader can reach it any more. The caller has
+  // already unlinked it.
+  template <typename U> void Retire(const U *object) {
+    Slot &slot = slots_[ThreadSlot()];
+    slot.retired.push_back(
+        {epoch_.load(), object,
+         [](const void *retired) { delete static_cast<const U *>(retired); }});
+    if (slot.retired.size() % kCollectInterval == 0) {
+      Collect(slot);
+    }
+  }
+
+private:
+  static constexpr uint64_t kUnpinned = 0;
+  static constexpr size_t kCollectInterval = 64;
+
+  struct Retired {
+    uint64_t epoch;
+    const void *object;
+    void (*deleter)(const void *);
+  };
+
+  // The pinned epoch of a thread and the objects it retired. Only the owning
+  // thread touches the retired list.
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<uint64_t> pinned{kUnpinned};
+    std::vector<Retired> retired;
+  };
+
+  // The slot indices are shared by every domain, and a thread gives its index
+  // back when it exits. |claimed_count| is one past the highest index ever
+  // claimed, which bounds the slots a reclaimer has to look at.
+  struct Registry {
+    std::array<std::atomic<bool>, kMaxThreads> claimed{};
+    std::atomic<size_t> claimed_count{0};
+  };
+
+  class ThreadIndex {
+  public:
+    ThreadIndex() : index_(Claim()) {}
+    ~ThreadIndex() { GetRegistry().claimed[index_].store(false); }
+
+    ThreadIndex(const ThreadIndex &) = delete;
+    ThreadIndex &operator=(const ThreadIndex &) = delete;
+
+    size_t Get() const { return index_; }
+
+  private:
+    size_t index_;
+
+    static size_t Claim() {
+      Registry &registry = GetRegistry();
+      for (size_t i = 0; i < kMaxThreads; i++) {
+        if (!registry.claimed[i].exchange(true)) {
+          size_t count = registry.claimed_count.load();
+          while (count < i + 1 &&
+                 !registry.claimed_count.compare_exchange_weak(count, i + 1)) {
+          }
+          return i;
+        }
+      }
+      // More threads than slots would let a reader go unseen.
+      std::abort();
+    }
+  };
+
+  std::atomic<uint64_t> epoch_{1};
+  std::vector<Slot> slots_;
+
+  static Registry &GetRegistry() {
+    static Registry registry;
+    return registry;
+  }
+
+  static size_t ThreadSlot() {
+    thread_local ThreadIndex index;
+    return index.Get();
+  }
+
+  // Advances the epoch if every pinned thread has seen the current one, and
+  // frees the objects of |slot| retired at least two epochs ago.
+  void Collect(Slot &slot) {
+    uint64_t epoch = epoch_.load();
+    bool advance = true;
+    size_t claimed_count = GetRegistry().claimed_count.load();
+    for (size_t i = 0; i < claimed_count; i++) {
+      uint64_t pinned = slots_[i].pinned.load();
+      if (pinned != kUnpinned && pinned != epoch) {
+        advance = false;
+        break;
+      }
+    }
+    if (advance && epoch_.compare_exchange_strong(epoch, epoch + 1)) {
+      epoch++;
+    }
+    size_t kept = 0;
+    for (const Retired &retired : slot.retired) {
+      if (retired.epoch + 2 <= epoch) {
+        retired.deleter(retired.object);
+      } else {
+        slot.retired[kept++] = retired;
+      }
+    }
+    slot.retired.resize(kept);
+  }
+};
+
+#endif // EPOCH_DOMAIN_H
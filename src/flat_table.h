@@ -0,0 +1,164 @@
+#ifndef FLAT_TABLE_H
+#define FLAT_TABLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*
+ * An open-addressing table that keeps the elements inline in a single
+ * contiguous array, so that a lookup touches one or two cache lines instead of
+ * chasing a pointer into a separately allocated bucket. It uses Robin Hood
+ * linear probing: next to the elements we keep one byte per slot holding the
+ * distance of its element from its home slot plus one, with zero marking an
+ * empty slot. An insertion displaces any element that is closer to its home
+ * than the element being inserted, which keeps probe sequences short and lets
+ * a lookup stop as soon as it meets an element closer to its home than the
+ * probe. Removal shifts the following elements of the cluster back by one slot
+ * instead of leaving a tombstone behind.
+ *
+ * The table is not thread safe, and requires T to be default constructible.
+ */
+template <typename T, typename Hash = std::hash<T>> class FlatTable {
+public:
+  explicit FlatTable(size_t capacity, Hash hash = Hash())
+      : hash_(std::move(hash)), elem_count_(0) {
+    size_t slot_count = kMinSlotCount;
+    while (slot_count < capacity) {
+      slot_count <<= 1;
+    }
+    dist_.resize(slot_count, kEmpty);
+    slots_.resize(slot_count);
+  }
+
+  // Adds |elem| to the table. Returns true if |elem| was absent, and false
+  // otherwise.
+  bool Insert(T elem) {
+    if (FindIndex(elem) != kNotFound) {
+      return false;
+    }
+    elem_count_++;
+    if (Policy()) {
+      Resize();
+    }
+    Place(std::move(elem));
+    return true;
+  }
+
+  // Removes |elem| from the table. Returns true if |elem| was present, and
+  // false otherwise.
+  bool Erase(const T &elem) {
+    size_t index = FindIndex(elem);
+    if (index == kNotFound) {
+      return false;
+    }
+    assert(elem_count_ != 0);
+    size_t next = (index + 1) & Mask();
+    while (dist_[next] > 1) {
+      slots_[index] = std::move(slots_[next]);
+      dist_[index] = static_cast<uint8_t>(dist_[next] - 1);
+      index = next;
+      next = (next + 1) & Mask();
+    }
+    dist_[index] = kEmpty;
+    slots_[index] = T();
+    elem_count_--;
+    return true;
+  }
+
+  // Returns true if |elem| is present in the table, and false otherwise.
+  [[nodiscard]] bool Contains(const T &elem) const {
+    return FindIndex(elem) != kNotFound;
+  }
+
+  // Returns the number of elements in the table.
+  [[nodiscard]] size_t Size() const { return elem_count_; }
+
+  // Grows the table, in a single rehash, to the size it would grow to while
+  // |elem_count| elements were inserted.
+  void Reserve(size_t elem_count) {
+    size_t slot_count = slots_.size();
+    while (elem_count * 8 > slot_count * 7) {
+      slot_count <<= 1;
+    }
+    if (slot_count > slots_.size()) {
+      Rehash(slot_count);
+    }
+  }
+
+private:
+  static constexpr size_t kMinSlotCount = 8;
+  static constexpr uint8_t kEmpty = 0;
+  static constexpr size_t kMaxDist = UINT8_MAX;
+  static constexpr size_t kNotFound = SIZE_MAX;
+
+  Hash hash_;
+  // The distance of the element in each slot from its home slot, plus one.
+  std::vector<uint8_t> dist_;
+  std::vector<T> slots_;
+  size_t elem_count_;
+
+  size_t Mask() const { return slots_.size() - 1; }
+
+  // We keep the load factor below 7/8, as Robin Hood probing keeps the
+  // average probe length short even when the table is mostly full.
+  bool Policy() { return elem_count_ * 8 > slots_.size() * 7; }
+
+  // A probe at distance |dist| from the home slot can stop at the first slot
+  // whose element is closer to its own home, since an insertion of |elem|
+  // would have displaced that element.
+  size_t FindIndex(const T &elem) const {
+    size_t index = hash_(elem) & Mask();
+    for (size_t dist = 1; dist <= dist_[index]; dist++) {
+      if (dist_[index] == dist && slots_[index] == elem) {
+        return index;
+      }
+      index = (index + 1) & Mask();
+    }
+    return kNotFound;
+  }
+
+  // Inserts an element known to be absent, displacing the elements that are
+  // closer to their home slot. If a probe gets longer than a distance byte can
+  // hold, we resize and insert the element we are carrying again.
+  void Place(T elem) {
+    size_t index = hash_(elem) & Mask();
+    size_t dist = 1;
+    while (dist_[index] != kEmpty) {
+      if (dist_[index] < dist) {
+        std::swap(slots_[index], elem);
+        size_t displaced = dist_[index];
+        dist_[index] = static_cast<uint8_t>(dist);
+        dist = displaced;
+      }
+      index = (index + 1) & Mask();
+      dist++;
+      if (dist > kMaxDist) {
+        Resize();
+        Place(std::move(elem));
+        return;
+      }
+    }
+    dist_[index] = static_cast<uint8_t>(dist);
+    slots_[index] = std::move(elem);
+  }
+
+  void Resize() { Rehash(2 * slots_.size()); }
+
+  void Rehash(size_t new_capacity) {
+    std::vector<uint8_t> dist(new_capacity, kEmpty);
+    std::vector<T> slots(new_capacity);
+    dist_.swap(dist);
+    slots_.swap(slots);
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (dist[i] != kEmpty) {
+        Place(std::move(slots[i]));
+      }
+    }
+  }
+};
+
+#endif // FLAT_TABLE_H
@@ -0,0 +1,64 @@
+#ifndef HASH_FUNCTIONS_H
+#define HASH_FUNCTIONS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Maps |hash| to one of |bucket_count| buckets. When the bucket count is a
+// power of two, which doubling the table preserves, we use a bitmask instead
+// of an integer division. Constructing a hash set with a power-of-two capacity
+// therefore selects the cheaper indexing for its whole lifetime.
+inline size_t BucketIndex(size_t hash, size_t bucket_count) {
+  if ((bucket_count & (bucket_count - 1)) == 0) {
+    return hash & (bucket_count - 1);
+  }
+  return hash % bucket_count;
+}
+
+// Finalizes a hash with a Fibonacci multiplication, folding the high half of
+// the product into the low half. The low bits of the result, which select the
+// bucket, then depend on every bit of the input.
+inline size_t MixHash(size_t hash) {
+  static_assert(sizeof(size_t) == 8, "MixHash assumes a 64-bit size_t");
+  hash *= 0x9E3779B97F4A7C15;
+  return hash ^ (hash >> 32);
+}
+
+// A drop-in replacement for std::hash that mixes its result. For integers,
+// std::hash is usually the identity, so that consecutive keys land in
+// neighbouring buckets and stripes, and keys with equal low bits collide in
+// power-of-two tables.
+template <typename T> class FastHash {
+public:
+  size_t operator()(const T &elem) const {
+    return MixHash(std::hash<T>()(elem));
+  }
+};
+
+// Whether |Hash| is transparent, as in the standard sets: it declares an
+// is_transparent member type, and hashes the keys it accepts that compare
+// equal to an element as it hashes the element. The hash sets that support it
+// then look elements up by such keys without constructing an element.
+template <typename Hash, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename Hash>
+struct IsTransparent<Hash, std::void_t<typename Hash::is_transparent>>
+    : std::true_type {};
+
+// A transparent hash for std::string elements, which also hashes
+// std::string_view and C strings, as std::hash<std::string> hashes the same
+// characters.
+class StringHash {
+public:
+  using is_transparent = void;
+
+  size_t operator()(std::string_view key) const {
+    return std::hash<std::string_view>()(key);
+  }
+};
+
+#endif // HASH_FUNCTIONS_H
@@ -0,0 +1,212 @@
+#ifndef HASH_MAP_REFINABLE_H
+#define HASH_MAP_REFINABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "src/cache_aligned.h"
+#include "src/epoch_domain.h"
+#include "src/hash_functions.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_stats.h"
+#include "src/map_entry.h"
+#include "src/resize_mode.h"
+#include "src/resize_policy.h"
+
+/*
+ * A hash map from K to V built on HashSetRefinable, whose elements are the
+ * entries of the map, see MapEntry. The map uses the bucket mutexes, the
+ * migration and the resize policy of the set as they are. Find takes no lock,
+ * like Contains: it pins an epoch and copies the value out of the published
+ * bucket. The updates lock the mutex of their key once, publish a copy of
+ * its bucket with the entry changed, as Add and Remove do, and check the
+ * policy once the mutex is released. A read-modify-write of a value, with
+ * Compute or Upsert, is then a single critical section, and lookups see the
+ * value either before or after it.
+ *
+ * The functions that Compute and Upsert call run under the bucket mutex, so
+ * they must be short and must not use the map.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename Mutex = CacheAligned<std::mutex>>
+class HashMapRefinable {
+public:
+  using KeyType = K;
+  using MappedType = V;
+  using Entry = MapEntry<K, V>;
+
+  explicit HashMapRefinable(size_t capacity,
+                            ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                            ResizePolicy resize_policy = ResizePolicy(),
+                            Hash hash = Hash())
+      : set_(capacity, resize_mode, resize_policy,
+             MapEntryHash<K, V, Hash>(std::move(hash))) {}
+
+  // Returns a copy of the value of |key|, or nothing if |key| is absent.
+  [[nodiscard]] std::optional<V> Find(const K &key) {
+    return FindHashed(key, set_.hash_(key));
+  }
+
+  // With a transparent Hash, see IsTransparent, keys can be looked up and
+  // removed by any type that Hash hashes and that compares equal to them.
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  [[nodiscard]] std::optional<V> Find(const Key &key) {
+    return FindHashed(key, set_.hash_(key));
+  }
+
+  [[nodiscard]] bool Contains(const K &key) { return set_.Contains(key); }
+
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  [[nodiscard]] bool Contains(const Key &key) {
+    return set_.Contains(key);
+  }
+
+  // Maps |key| to |value|. Returns true if |key| was absent, and false if its
+  // value was replaced.
+  bool InsertOrAssign(K key, V value) {
+    size_t hash = set_.hash_(key);
+    bool inserted;
+    {
+      typename Set::CustomScopedLock customScopedLock(&set_, hash);
+      std::atomic<const Bucket *> &slot = set_.SlotNoLock(hash);
+      Bucket *copy = Set::CopyOf(slot.load(), 1);
+      Entry *entry = EntryOf(*copy, key);
+      inserted = entry == nullptr;
+      if (inserted) {
+        copy->push_back(Entry{std::move(key), std::move(value)});
+        set_.elem_count_.Add(set_.elem_count_.ShardOf(hash));
+      } else {
+        entry->value = std::move(value);
+      }
+      set_.Publish(slot, copy);
+    }
+    if (inserted) {
+      set_.ResizeIfDue(hash);
+    }
+    return inserted;
+  }
+
+  // Calls |fn| with the value of |key|, as an std::optional<V> that is empty
+  // if |key| is absent. |key| then maps to the value |fn| leaves in it, or is
+  // removed if |fn| leaves it empty. Returns whether |key| is present
+  // afterwards.
+  template <typename Fn> bool Compute(const K &key, Fn fn) {
+    size_t hash = set_.hash_(key);
+    bool count_changed = false;
+    std::optional<V> value;
+    {
+      typename Set::CustomScopedLock customScopedLock(&set_, hash);
+      std::atomic<const Bucket *> &slot = set_.SlotNoLock(hash);
+      const Bucket *bucket = slot.load();
+      const Entry *entry = Set::BucketFind(bucket, key);
+      if (entry != nullptr) {
+        value = entry->value;
+      }
+      fn(value);
+      if (entry != nullptr && !value.has_value()) {
+        set_.RemoveNoLock(key, hash);
+        count_changed = true;
+      } else if (value.has_value()) {
+        Bucket *copy = Set::CopyOf(bucket, entry == nullptr ? 1 : 0);
+        Entry *copied = EntryOf(*copy, key);
+        if (copied != nullptr) {
+          copied->value = std::move(*value);
+        } else {
+          copy->push_back(Entry{key, std::move(*value)});
+          set_.elem_count_.Add(set_.elem_count_.ShardOf(hash));
+          count_changed = true;
+        }
+        set_.Publish(slot, copy);
+      }
+    }
+    if (count_changed) {
+      set_.ResizeIfDue(hash);
+    }
+    return value.has_value();
+  }
+
+  // Maps |key| to |value| if it is absent, and otherwise calls |fn| on its
+  // value, which it modifies in place in the copy of the bucket. Returns true
+  // if |key| was absent.
+  template <typename Fn> bool Upsert(K key, V value, Fn fn) {
+    size_t hash = set_.hash_(key);
+    bool inserted;
+    {
+      typename Set::CustomScopedLock customScopedLock(&set_, hash);
+      std::atomic<const Bucket *> &slot = set_.SlotNoLock(hash);
+      Bucket *copy = Set::CopyOf(slot.load(), 1);
+      Entry *entry = EntryOf(*copy, key);
+      inserted = entry == nullptr;
+      if (inserted) {
+        copy->push_back(Entry{std::move(key), std::move(value)});
+        set_.elem_count_.Add(set_.elem_count_.ShardOf(hash));
+      } else {
+        fn(entry->value);
+      }
+      set_.Publish(slot, copy);
+    }
+    if (inserted) {
+      set_.ResizeIfDue(hash);
+    }
+    return inserted;
+  }
+
+  // Removes |key| and its value. Returns true if |key| was present.
+  bool Remove(const K &key) { return set_.Remove(key); }
+
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  bool Remove(const Key &key) {
+    return set_.Remove(key);
+  }
+
+  [[nodiscard]] size_t Size() const { return set_.Size(); }
+
+  void Reserve(size_t entry_count) { set_.Reserve(entry_count); }
+
+  // Calls |fn(key, value)| on every entry, with the weakly consistent scan of
+  // HashSetRefinable::ForEach, on copies of the entries.
+  template <typename Fn> void ForEach(Fn fn) {
+    set_.ForEach([&](const Entry &entry) { fn(entry.key, entry.value); });
+  }
+
+#ifdef HASH_SET_STATS
+  [[nodiscard]] HashSetStats Stats() { return set_.Stats(); }
+#endif
+
+private:
+  using Set = HashSetRefinable<Entry, MapEntryHash<K, V, Hash>, Mutex>;
+  using Bucket = typename Set::Bucket;
+
+  Set set_;
+
+  // The entry of |key| in |bucket|, a copy that is not published yet, or
+  // null.
+  template <typename Key>
+  static Entry *EntryOf(Bucket &bucket, const Key &key) {
+    auto it = std::find(bucket.begin(), bucket.end(), key);
+    return it != bucket.end() ? &*it : nullptr;
+  }
+
+  // The value is copied while the epoch is pinned, since the bucket it is
+  // read from may be retired as soon as it is unpinned.
+  template <typename Key>
+  std::optional<V> FindHashed(const Key &key, size_t hash) {
+    EpochDomain::Guard guard(set_.epochs_);
+    const Entry *entry = set_.FindPinned(key, hash);
+    if (entry == nullptr) {
+      return std::nullopt;
+    }
+    return entry->value;
+  }
+};
+
+#endif // HASH_MAP_REFINABLE_H
@@ -0,0 +1,189 @@
+#ifndef HASH_MAP_STRIPED_H
+#define HASH_MAP_STRIPED_H
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "src/cache_aligned.h"
+#include "src/hash_functions.h"
+#include "src/hash_set_stats.h"
+#include "src/hash_set_striped.h"
+#include "src/map_entry.h"
+#include "src/reader_lock.h"
+#include "src/resize_mode.h"
+#include "src/resize_policy.h"
+
+/*
+ * A hash map from K to V built on HashSetStriped, whose elements are the
+ * entries of the map, see MapEntry. The map uses the stripe locks, the
+ * incremental migration and the resize policy of the set as they are: each
+ * operation hashes its key once, locks the stripe of the key once, finds the
+ * entry and updates its value in place, and checks the policy once the lock
+ * is released. A read-modify-write of a value, with Compute or Upsert, is
+ * then a single critical section.
+ *
+ * The functions that Compute and Upsert call run under the stripe lock, so
+ * they must be short and must not use the map.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>,
+          typename Mutex = CacheAligned<std::mutex>>
+class HashMapStriped {
+public:
+  using KeyType = K;
+  using MappedType = V;
+  using Entry = MapEntry<K, V>;
+
+  explicit HashMapStriped(size_t capacity,
+                          ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                          ResizePolicy resize_policy = ResizePolicy(),
+                          Hash hash = Hash())
+      : set_(capacity, resize_mode, resize_policy,
+             MapEntryHash<K, V, Hash>(std::move(hash))) {}
+
+  // Returns a copy of the value of |key|, or nothing if |key| is absent. The
+  // stripe is only locked for reading when the Mutex allows it.
+  [[nodiscard]] std::optional<V> Find(const K &key) {
+    return FindHashed(key, set_.hash_(key));
+  }
+
+  // With a transparent Hash, see IsTransparent, keys can be looked up and
+  // removed by any type that Hash hashes and that compares equal to them.
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  [[nodiscard]] std::optional<V> Find(const Key &key) {
+    return FindHashed(key, set_.hash_(key));
+  }
+
+  [[nodiscard]] bool Contains(const K &key) { return set_.Contains(key); }
+
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  [[nodiscard]] bool Contains(const Key &key) {
+    return set_.Contains(key);
+  }
+
+  // Maps |key| to |value|. Returns true if |key| was absent, and false if its
+  // value was replaced.
+  bool InsertOrAssign(K key, V value) {
+    size_t hash = set_.hash_(key);
+    bool inserted = set_.template WithStripeLock<WriterLock>(
+        hash, [&](size_t my_lock) {
+          Entry *entry = set_.FindNoLock(key, hash, my_lock);
+          if (entry != nullptr) {
+            entry->value = std::move(value);
+            return false;
+          }
+          set_.InsertNoLock(Entry{std::move(key), std::move(value)}, hash);
+          return true;
+        });
+    if (inserted) {
+      set_.ResizeIfDue(hash);
+    }
+    return inserted;
+  }
+
+  // Calls |fn| with the value of |key|, as an std::optional<V> that is empty
+  // if |key| is absent. |key| then maps to the value |fn| leaves in it, or is
+  // removed if |fn| leaves it empty. Returns whether |key| is present
+  // afterwards.
+  template <typename Fn> bool Compute(const K &key, Fn fn) {
+    size_t hash = set_.hash_(key);
+    bool count_changed = false;
+    // As in Remove, an entry removed is only destroyed after the lock.
+    std::optional<Entry> removed;
+    bool present = set_.template WithStripeLock<WriterLock>(
+        hash, [&](size_t my_lock) {
+          Entry *entry = set_.FindNoLock(key, hash, my_lock);
+          std::optional<V> value;
+          if (entry != nullptr) {
+            value = std::move(entry->value);
+          }
+          fn(value);
+          if (entry != nullptr && value.has_value()) {
+            entry->value = std::move(*value);
+          } else if (entry != nullptr) {
+            removed = set_.RemoveNoLock(key, hash, my_lock);
+            count_changed = true;
+          } else if (value.has_value()) {
+            set_.InsertNoLock(Entry{key, std::move(*value)}, hash);
+            count_changed = true;
+          }
+          return value.has_value();
+        });
+    removed.reset();
+    if (count_changed) {
+      set_.ResizeIfDue(hash);
+    }
+    return present;
+  }
+
+  // Maps |key| to |value| if it is absent, and otherwise calls |fn| on its
+  // value, which it modifies in place. Returns true if |key| was absent.
+  template <typename Fn> bool Upsert(K key, V value, Fn fn) {
+    size_t hash = set_.hash_(key);
+    bool inserted = set_.template WithStripeLock<WriterLock>(
+        hash, [&](size_t my_lock) {
+          Entry *entry = set_.FindNoLock(key, hash, my_lock);
+          if (entry != nullptr) {
+            fn(entry->value);
+            return false;
+          }
+          set_.InsertNoLock(Entry{std::move(key), std::move(value)}, hash);
+          return true;
+        });
+    if (inserted) {
+      set_.ResizeIfDue(hash);
+    }
+    return inserted;
+  }
+
+  // Removes |key| and its value. Returns true if |key| was present.
+  bool Remove(const K &key) { return set_.Remove(key); }
+
+  template <typename Key,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, Key>>
+  bool Remove(const Key &key) {
+    return set_.Remove(key);
+  }
+
+  [[nodiscard]] size_t Size() const { return set_.Size(); }
+
+  void Reserve(size_t entry_count) { set_.Reserve(entry_count); }
+
+  // Calls |fn(key, value)| on every entry, with the weakly consistent scan of
+  // HashSetStriped::ForEach, on copies of the entries.
+  template <typename Fn> void ForEach(Fn fn) {
+    set_.ForEach([&](const Entry &entry) { fn(entry.key, entry.value); });
+  }
+
+#ifdef HASH_SET_STATS
+  [[nodiscard]] HashSetStats Stats() { return set_.Stats(); }
+#endif
+
+private:
+  using Set = HashSetStriped<Entry, MapEntryHash<K, V, Hash>, Mutex>;
+  using WriterLock = std::scoped_lock<typename Set::StripeMutex>;
+  using ReaderLock = ScopedReaderLock<typename Set::StripeMutex>;
+
+  Set set_;
+
+  template <typename Key>
+  std::optional<V> FindHashed(const Key &key, size_t hash) {
+    std::optional<V> value;
+    set_.template WithStripeLock<ReaderLock>(
+        hash, [&](size_t my_lock) {
+          const Entry *entry = set_.FindReader(key, hash, my_lock);
+          if (entry != nullptr) {
+            value = entry->value;
+          }
+          return entry != nullptr;
+        });
+    return value;
+  }
+};
+
+#endif // HASH_MAP_STRIPED_H
@@ -2,24 +2,92 @@
 #define HASH_SET_BASE_H
 
 #include <cstddef>
+#include <vector>
 
-template <typename T> class HashSetBase {
+#include "src/hash_set_stats.h"
+
+/*
+ * The interface of the hash sets, dispatched statically: a hash set derives
+ * from HashSetBase<itself, T> and defines
+ *
+ *   bool Add(T elem), which adds |elem| and returns true if it was absent;
+ *   bool Remove(T elem), which removes |elem| and returns true if it was
+ *     present;
+ *   [[nodiscard]] bool Contains(T elem), which returns true if |elem| is
+ *     present;
+ *   [[nodiscard]] size_t Size() const, which returns the size of the set;
+ *   void Reserve(size_t elem_count), which grows the hash set at once to the
+ *     size it would grow to while |elem_count| elements were added.
+ *
+ * Each hash set also has a bulk constructor, which takes a vector of elements
+ * before the arguments of its other constructor, and sizes the hash set for
+ * them before adding them.
+ *
+ * A hash set may take its elements by reference instead. HashSetStriped and
+ * HashSetRefinable do, hash each element once per operation, move rvalues
+ * into their buckets, and add Emplace. With a transparent hash, see
+ * IsTransparent in hash_functions.h, their Remove and Contains also take keys
+ * of other types, such as std::string_view for std::string elements.
+ *
+ * Callers take the hash set type as a template parameter, so that these calls
+ * can be inlined. The batch operations below are built on them, and a hash set
+ * may define batch operations of its own, which hide these. HashSetAdapter in
+ * hash_set_interface.h wraps a hash set behind virtual functions for callers
+ * that pick the hash set at run time.
+ */
+template <typename Derived, typename T> class HashSetBase {
 public:
-  virtual ~HashSetBase() = default;
+  using ValueType = T;
+
+  // Adds every element of |elems| to the hash set. Returns the number of
+  // elements that were absent. Implementations may lock and resize once per
+  // batch instead of once per element.
+  size_t AddAll(const std::vector<T> &elems) {
+    size_t added = 0;
+    for (const T &elem : elems) {
+      if (Self().Add(elem)) {
+        added++;
+      }
+    }
+    return added;
+  }
+
+  // Removes every element of |elems| from the hash set. Returns the number of
+  // elements that were present.
+  size_t RemoveAll(const std::vector<T> &elems) {
+    size_t removed = 0;
+    for (const T &elem : elems) {
+      if (Self().Remove(elem)) {
+        removed++;
+      }
+    }
+    return removed;
+  }
 
-  // Adds |elem| to the hash set. Returns true if |elem| was absent, and false
-  // otherwise.
-  virtual bool Add(T elem) = 0;
+  // Returns, for each element of |elems|, whether it is present in the hash
+  // set.
+  [[nodiscard]] std::vector<bool> ContainsMany(const std::vector<T> &elems) {
+    std::vector<bool> results;
+    results.reserve(elems.size());
+    for (const T &elem : elems) {
+      results.push_back(Self().Contains(elem));
+    }
+    return results;
+  }
 
-  // Removes |elem| from the hash set. Returns true if |elem| was present, and
-  // false otherwise.
-  virtual bool Remove(T elem) = 0;
+#ifdef HASH_SET_STATS
+  // Returns the counters of the hash set, see hash_set_stats.h. Hash sets
+  // without locks or buckets leave those counters empty. It may lock the
+  // whole hash set to read the bucket lengths.
+  [[nodiscard]] HashSetStats Stats() { return HashSetStats(); }
+#endif
 
-  // Returns true if |elem| is present in the hash set, and false otherwise.
-  [[nodiscard]] virtual bool Contains(T elem) = 0;
+protected:
+  HashSetBase() = default;
+  ~HashSetBase() = default;
 
-  // Returns the size of the hash set.
-  [[nodiscard]] virtual size_t Size() const = 0;
+private:
+  Derived &Self() { return static_cast<Derived &>(*this); }
 };
 
 #endif // HASH_SET_BASE_H
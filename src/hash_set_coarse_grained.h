@@ -4,10 +4,16 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <utility>
 #include <vector>
 
+#include "src/hash_functions.h"
 #include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/resize_policy.h"
 
 /*
  * The coarse grained implementation of the concurrent hashset is mainly a
@@ -17,87 +23,205 @@
  * remove. Bucket_count_ is atomic due to the reason that Policy now occurs when
  * threads have no locks, so there is a potential data race in that specific
  * point. Atomicity makes sure that the value can be updated in one step,
- * avoiding the potential data race.
+ * avoiding the potential data race. The buckets allocate their storage with
+ * |Allocator|, such as the SlabAllocator of slab_allocator.h.
  */
-template <typename T> class HashSetCoarseGrained : public HashSetBase<T> {
+template <typename T, typename Hash = std::hash<T>,
+          typename Allocator = std::allocator<T>>
+class HashSetCoarseGrained
+    : public HashSetBase<HashSetCoarseGrained<T, Hash, Allocator>, T> {
 public:
-  explicit HashSetCoarseGrained(size_t capacity)
-      : bucket_count_(capacity), elem_count_(0) {
-    table_.resize(bucket_count_);
-    for (size_t i = 0; i < bucket_count_; i++) {
-      table_[i] = std::vector<T>();
-    }
+  explicit HashSetCoarseGrained(size_t capacity,
+                                ResizePolicy resize_policy = ResizePolicy(),
+                                Hash hash = Hash())
+      : hash_(std::move(hash)), bucket_count_(capacity),
+        min_bucket_count_(capacity), elem_count_(0),
+        resize_policy_(resize_policy) {
+    table_ = MakeTable(bucket_count_);
+  }
+
+  // Builds the hash set of |elems| with a table sized for all of them.
+  HashSetCoarseGrained(const std::vector<T> &elems, size_t capacity,
+                       ResizePolicy resize_policy = ResizePolicy(),
+                       Hash hash = Hash())
+      : HashSetCoarseGrained(capacity, resize_policy, std::move(hash)) {
+    Reserve(elems.size());
+    AddAll(elems);
   }
 
   // We use a scoped lock to ensure that the buckets are not changed during the
   // add function.
-  bool Add(T elem) final {
-    std::scoped_lock<std::mutex> lock(mutex_);
+  bool Add(T elem) {
+    std::scoped_lock<Mutex> lock(mutex_);
     if (ContainsNoLock(elem))
       return false;
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
     table_[my_bucket].push_back(elem);
     elem_count_.fetch_add(1);
     if (Policy()) {
+      stats_.PolicyTriggered();
       Resize();
     }
     return true;
   }
 
   // We lock the global mutex until the remove command is finished.
-  bool Remove(T elem) final {
-    std::scoped_lock<std::mutex> lock(mutex_);
+  bool Remove(T elem) {
+    std::scoped_lock<Mutex> lock(mutex_);
     if (!ContainsNoLock(elem))
       return false;
     assert(elem_count_ != 0);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
     table_[my_bucket].erase(
         std::find(table_[my_bucket].begin(), table_[my_bucket].end(), elem));
     elem_count_.fetch_sub(1);
+    if (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
     return true;
   }
 
   // We lock the global mutex to ensure that the hash set is not changed during
   // the check function.
-  [[nodiscard]] bool Contains(T elem) final {
-    std::scoped_lock<std::mutex> lock(mutex_);
+  [[nodiscard]] bool Contains(T elem) {
+    std::scoped_lock<Mutex> lock(mutex_);
     return ContainsNoLock(elem);
   }
 
-  [[nodiscard]] size_t Size() const final { return elem_count_.load(); }
+  [[nodiscard]] size_t Size() const { return elem_count_.load(); }
+
+  // Grows the table, in a single rehash, to the size it would grow to while
+  // |elem_count| elements were added, and keeps it from shrinking below that
+  // size.
+  void Reserve(size_t elem_count) {
+    std::scoped_lock<Mutex> lock(mutex_);
+    min_bucket_count_ =
+        resize_policy_.BucketCountFor(elem_count, min_bucket_count_);
+    if (min_bucket_count_ > bucket_count_) {
+      Rehash(min_bucket_count_);
+    }
+  }
+
+#ifdef HASH_SET_STATS
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    StatsRecorder::ReportLock(mutex_, stats);
+    stats_.Report(stats);
+    std::scoped_lock<Mutex> lock(mutex_);
+    StatsRecorder::ReportBuckets(table_, stats);
+    stats.average_bucket_length = static_cast<double>(elem_count_.load()) /
+                                  static_cast<double>(bucket_count_);
+    return stats;
+  }
+#endif
+
+  // The batch operations lock the global mutex once for the whole batch.
+  size_t AddAll(const std::vector<T> &elems) {
+    std::scoped_lock<Mutex> lock(mutex_);
+    size_t added = 0;
+    for (const T &elem : elems) {
+      if (!ContainsNoLock(elem)) {
+        table_[BucketIndex(hash_(elem), bucket_count_)].push_back(elem);
+        added++;
+      }
+    }
+    elem_count_.fetch_add(added);
+    while (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
+    return added;
+  }
+
+  size_t RemoveAll(const std::vector<T> &elems) {
+    std::scoped_lock<Mutex> lock(mutex_);
+    size_t removed = 0;
+    for (const T &elem : elems) {
+      Bucket &bucket = table_[BucketIndex(hash_(elem), bucket_count_)];
+      auto it = std::find(bucket.begin(), bucket.end(), elem);
+      if (it != bucket.end()) {
+        bucket.erase(it);
+        removed++;
+      }
+    }
+    elem_count_.fetch_sub(removed);
+    while (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
+    return removed;
+  }
+
+  [[nodiscard]] std::vector<bool>
+  ContainsMany(const std::vector<T> &elems) {
+    std::scoped_lock<Mutex> lock(mutex_);
+    std::vector<bool> results;
+    results.reserve(elems.size());
+    for (const T &elem : elems) {
+      results.push_back(ContainsNoLock(elem));
+    }
+    return results;
+  }
 
 private:
-  std::vector<std::vector<T>> table_;
+  // The mutex counts its acquisitions when the stats are compiled in.
+  using Mutex = StatsMutex<std::mutex>;
+
+  using Bucket = std::vector<T, Allocator>;
+
+  Hash hash_;
+  // Every bucket allocates from a copy of |allocator_|, which only the holder
+  // of the global mutex uses.
+  Allocator allocator_;
+  std::vector<Bucket> table_;
   size_t bucket_count_;
+  // The table never shrinks below its initial or reserved bucket count.
+  size_t min_bucket_count_;
   // We ensure that the element count is right by making it an atomic variable.
   std::atomic<size_t> elem_count_;
   // We have a single mutex for all operations of the hash set.
-  std::mutex mutex_;
+  Mutex mutex_;
+  ResizePolicy resize_policy_;
+  StatsRecorder stats_;
 
   bool ContainsNoLock(T elem) {
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
-    std::vector<T> small_table = table_[my_bucket];
-    return std::find(small_table.begin(), small_table.end(), elem) !=
-           small_table.end();
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
+    const Bucket &bucket = table_[my_bucket];
+    return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
+  }
+
+  bool Policy() { return NewBucketCount() != bucket_count_; }
+
+  size_t NewBucketCount() {
+    return resize_policy_.TargetBucketCount(elem_count_.load(), bucket_count_,
+                                            min_bucket_count_);
   }
 
-  bool Policy() { return (elem_count_.load() / bucket_count_) > 4; }
+  void Resize() { Rehash(NewBucketCount()); }
 
-  void Resize() {
-    size_t old_capacity = bucket_count_;
-    size_t new_capacity = 2 * old_capacity;
+  void Rehash(size_t new_capacity) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
     bucket_count_ = new_capacity;
-    std::vector<std::vector<T>> table;
-    table.resize(new_capacity);
-    for (size_t i = 0; i < new_capacity; i++) {
-      table[i] = std::vector<T>();
+    // Moving the elements into pre-sized buckets keeps the critical section to
+    // one allocation per new bucket.
+    std::vector<Bucket> table = MakeTable(new_capacity);
+    size_t bucket_size = elem_count_.load() / new_capacity + 1;
+    for (Bucket &bucket : table) {
+      bucket.reserve(bucket_size);
     }
-    for (std::vector<T> bucket : table_) {
-      for (T elem : bucket) {
-        table[std::hash<T>()(elem) % new_capacity].push_back(elem);
+    for (Bucket &bucket : table_) {
+      for (T &elem : bucket) {
+        table[BucketIndex(hash_(elem), new_capacity)].push_back(
+            std::move(elem));
       }
     }
-    table_ = table;
+    table_.swap(table);
+    stats_.Resized(begin_time);
+  }
+
+  std::vector<Bucket> MakeTable(size_t bucket_count) {
+    return std::vector<Bucket>(bucket_count, Bucket(allocator_));
   }
 };
 
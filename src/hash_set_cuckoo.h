@@ -0,0 +1,481 @@
+#ifndef HASH_SET_CUCKOO_H
+#define HASH_SET_CUCKOO_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "src/cache_aligned.h"
+#include "src/hash_functions.h"
+#include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/reader_lock.h"
+#include "src/resize_policy.h"
+#include "src/scoped_vector_lock.h"
+#include "src/sharded_counter.h"
+#include "src/simd_find.h"
+
+/*
+ * The cuckoo hash set follows the StripedCuckooHashSet of the Art of
+ * Multiprocessor Programming: there are two tables, each with its own hash
+ * function and its own array of striped locks, and an element lives in one of
+ * its two buckets, one per table. If both buckets are full, an Add displaces
+ * an element of one of them into its bucket in the other table, which may in
+ * turn displace another, and grows the tables if that chain gets too long.
+ *
+ * Instead of the probe sets of the book, each bucket holds up to
+ * kSlotsPerBucket elements inline and is aligned so that it does not straddle
+ * a cache line it could fit on. A lookup therefore scans a bounded number of
+ * elements on at most two cache lines, however the keys are distributed, and
+ * for integer keys it compares a whole bucket at once, see simd_find.h.
+ *
+ * An operation locks the stripe of its element in the first lock array and
+ * then the one in the second, so that two operations never wait for each
+ * other in a cycle. As in the book's relocate, an Add whose buckets are both
+ * full displaces elements without stopping the other stripes: it finds a
+ * chain of buckets, each holding an element whose other bucket is the next
+ * one, up to one with room, and then moves those elements one at a time,
+ * from the end of the chain, each under the locks of its own two buckets.
+ * Only a rebuild, when a chain gets longer than kMaxDisplacements or the
+ * tables are more than kMaxLoadNumerator / kMaxLoadDenominator full, locks
+ * every stripe. The tables only grow. T must be default constructible and
+ * copyable, and at most 2 * kSlotsPerBucket elements may share a hash.
+ *
+ * The lock arrays grow with the tables, as the ResizePolicy of the striped
+ * hash set says, up to a cap tied to the hardware concurrency. Every lock is
+ * allocated up front and the lock count only changes while all of them are
+ * held, so an operation that waited for its locks during a rebuild notices
+ * the new count once it holds them, and tries again.
+ *
+ * When the Mutex can be locked for reading, lookups only lock their stripes
+ * for reading, as in the striped hash set.
+ */
+template <typename T, typename Hash = std::hash<T>,
+          typename Mutex = CacheAligned<std::mutex>>
+class HashSetCuckoo : public HashSetBase<HashSetCuckoo<T, Hash, Mutex>, T> {
+public:
+  explicit HashSetCuckoo(size_t capacity, Hash hash = Hash())
+      : hash_(std::move(hash)), bucket_count_(capacity),
+        lock_count_(capacity), elem_count_(capacity), next_victim_(0) {
+    size_t max_lock_count = lock_policy_.TargetLockCount(
+        std::numeric_limits<size_t>::max(), capacity);
+    for (size_t table = 0; table < kTableCount; table++) {
+      tables_[table] = std::vector<Bucket>(capacity);
+      mutexes_[table] = std::vector<StripeMutex>(max_lock_count);
+    }
+  }
+
+  // Builds the hash set of |elems| with tables sized for all of them. The
+  // elements are added by the calling thread, since a displacement chain may
+  // run through any bucket.
+  HashSetCuckoo(const std::vector<T> &elems, size_t capacity,
+                Hash hash = Hash())
+      : HashSetCuckoo(capacity, std::move(hash)) {
+    Reserve(elems.size());
+    for (const T &elem : elems) {
+      Add(elem);
+    }
+  }
+
+  // We lock both stripes of the element, and add it to whichever of its
+  // buckets has room. If neither does, we make room in its first bucket by
+  // displacing elements, or grow the tables, and try again.
+  bool Add(T elem) {
+    size_t hash = hash_(elem);
+    while (true) {
+      // The bucket count the buckets of |elem| were found full with.
+      size_t bucket_count = 0;
+      std::optional<bool> added = WithLocks<std::scoped_lock<StripeMutex>>(
+          hash, [&]() -> std::optional<bool> {
+            if (ContainsNoLock(elem, hash)) {
+              return false;
+            }
+            for (size_t table = 0; table < kTableCount; table++) {
+              if (BucketOf(table, hash).Push(elem)) {
+                elem_count_.Add(elem_count_.ShardOf(hash));
+                return true;
+              }
+            }
+            bucket_count = bucket_count_.load();
+            return std::nullopt;
+          });
+      if (added.has_value()) {
+        return *added;
+      }
+      if (Overloaded(elem_count_.Sum() + 1, bucket_count) ||
+          !Displace(hash, bucket_count)) {
+        stats_.PolicyTriggered();
+        Grow(bucket_count);
+      }
+    }
+  }
+
+  // An element is removed by moving the last element of its bucket into its
+  // slot, so the elements of a bucket stay packed at its front.
+  bool Remove(T elem) {
+    size_t hash = hash_(elem);
+    return WithLocks<std::scoped_lock<StripeMutex>>(hash, [&] {
+      for (size_t table = 0; table < kTableCount; table++) {
+        if (BucketOf(table, hash).Erase(elem)) {
+          size_t shard = elem_count_.ShardOf(hash);
+          assert(elem_count_.Get(shard) != 0);
+          elem_count_.Sub(shard);
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
+  [[nodiscard]] bool Contains(T elem) {
+    size_t hash = hash_(elem);
+    return WithLocks<ScopedReaderLock<StripeMutex>>(
+        hash, [&] { return ContainsNoLock(elem, hash); });
+  }
+
+  [[nodiscard]] size_t Size() const { return elem_count_.Sum(); }
+
+  // Grows the tables, in a single rebuild, to the size they would grow to
+  // while |elem_count| elements were added.
+  void Reserve(size_t elem_count) {
+    ScopedVectorLock<StripeMutex> first_locks(mutexes_[0]);
+    ScopedVectorLock<StripeMutex> second_locks(mutexes_[1]);
+    size_t bucket_count = bucket_count_.load();
+    while (Overloaded(elem_count, bucket_count)) {
+      bucket_count *= 2;
+    }
+    if (bucket_count > bucket_count_.load()) {
+      Rebuild(bucket_count);
+    }
+  }
+
+#ifdef HASH_SET_STATS
+  // The lock counters are read before we lock the whole hash set to scan the
+  // buckets, so that they do not include our own acquisitions. The bucket
+  // lengths are counted over the buckets of both tables.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    for (const std::vector<StripeMutex> &mutexes : mutexes_) {
+      for (size_t i = 0; i < lock_count_.load(); i++) {
+        StatsRecorder::ReportLock(mutexes[i], stats);
+      }
+    }
+    stats_.Report(stats);
+    ScopedVectorLock<StripeMutex> first_locks(mutexes_[0]);
+    ScopedVectorLock<StripeMutex> second_locks(mutexes_[1]);
+    for (const std::vector<Bucket> &table : tables_) {
+      for (const Bucket &bucket : table) {
+        stats.max_bucket_length =
+            std::max(stats.max_bucket_length, bucket.Size());
+      }
+    }
+    stats.average_bucket_length =
+        static_cast<double>(elem_count_.Sum()) /
+        static_cast<double>(kTableCount * bucket_count_.load());
+    return stats;
+  }
+#endif
+
+private:
+  // The mutexes count their acquisitions when the stats are compiled in.
+  using StripeMutex = StatsMutex<Mutex>;
+
+  static constexpr size_t kTableCount = 2;
+  static constexpr size_t kSlotsPerBucket = 4;
+  // The longest chain of displacements an Add looks for before it grows the
+  // tables instead.
+  static constexpr size_t kMaxDisplacements = 32;
+  static constexpr size_t kMaxLoadNumerator = 3;
+  static constexpr size_t kMaxLoadDenominator = 4;
+
+  // The elements of a bucket are packed into its first Size() slots.
+  class alignas(CacheFriendlyAlignment(
+      sizeof(std::array<T, kSlotsPerBucket>) + sizeof(uint8_t),
+      alignof(T))) Bucket {
+  public:
+    [[nodiscard]] size_t Size() const { return size_; }
+
+    T &At(size_t slot) { return slots_[slot]; }
+
+    [[nodiscard]] bool Contains(const T &elem) const {
+      return FindIndex(slots_.data(), size_, elem, kSlotsPerBucket) != size_;
+    }
+
+    // Returns false if the bucket is full.
+    bool Push(T elem) {
+      if (size_ == kSlotsPerBucket) {
+        return false;
+      }
+      slots_[size_++] = std::move(elem);
+      return true;
+    }
+
+    bool Erase(const T &elem) {
+      size_t index = FindIndex(slots_.data(), size_, elem, kSlotsPerBucket);
+      if (index == size_) {
+        return false;
+      }
+      size_--;
+      if (index != size_) {
+        slots_[index] = std::move(slots_[size_]);
+      }
+      slots_[size_] = T();
+      return true;
+    }
+
+  private:
+    std::array<T, kSlotsPerBucket> slots_;
+    uint8_t size_ = 0;
+  };
+
+  // The moves of a displacement chain: |elem|, with |hash|, moves out of its
+  // bucket in one table into its bucket in the other.
+  struct Displacement {
+    T elem;
+    size_t hash;
+  };
+
+  Hash hash_;
+  std::array<std::vector<Bucket>, kTableCount> tables_;
+  // The bucket count of each table. It only changes while all the locks are
+  // held, so reading it under any lock is safe.
+  std::atomic<size_t> bucket_count_;
+  // The number of locks in use in each table, which divides the bucket
+  // count, so bucket i is guarded by lock i % |lock_count_|. It only changes
+  // while all the locks are held.
+  std::atomic<size_t> lock_count_;
+  // Only the lock count of the policy is used: the tables grow by their own
+  // load limit and chain length.
+  const ResizePolicy lock_policy_;
+  // The element count is sharded by hash, so that operations on separate
+  // stripes mostly update separate cache lines.
+  ShardedCounter elem_count_;
+  // A vector of as many mutexes as the lock count can grow to for each table,
+  // each padded to a cache line by default.
+  std::array<std::vector<StripeMutex>, kTableCount> mutexes_;
+  // The slot the next displacement evicts. Rotating it keeps chains from
+  // cycling through the same few elements.
+  std::atomic<size_t> next_victim_;
+
+  StatsRecorder stats_;
+
+  // The second table indexes its buckets with a mixed copy of the hash, so
+  // that the elements sharing a bucket of the first table are spread over the
+  // second one.
+  static size_t TableHash(size_t table, size_t hash) {
+    return table == 0 ? hash : MixHash(hash);
+  }
+
+  // Calls |fn| while holding the stripes of the element with |hash| in both
+  // tables, with |Lock| guards, and returns what it returns.
+  template <typename Lock, typename Fn> auto WithLocks(size_t hash, Fn fn) {
+    while (true) {
+      size_t lock_count = lock_count_.load();
+      Lock first_lock(LockOf(0, hash, lock_count));
+      Lock second_lock(LockOf(1, hash, lock_count));
+      if (lock_count_.load() == lock_count) {
+        return fn();
+      }
+    }
+  }
+
+  StripeMutex &LockOf(size_t table, size_t hash, size_t lock_count) {
+    return mutexes_[table][BucketIndex(TableHash(table, hash), lock_count)];
+  }
+
+  Bucket &BucketOf(size_t table, size_t hash) {
+    size_t index = BucketIndex(TableHash(table, hash), bucket_count_.load());
+    return tables_[table][index];
+  }
+
+  bool ContainsNoLock(const T &elem, size_t hash) {
+    return BucketOf(0, hash).Contains(elem) ||
+           BucketOf(1, hash).Contains(elem);
+  }
+
+  static bool Overloaded(size_t elem_count, size_t bucket_count) {
+    return elem_count * kMaxLoadDenominator >
+           kTableCount * bucket_count * kSlotsPerBucket * kMaxLoadNumerator;
+  }
+
+  // Makes room in the first bucket of the element with |hash|, which was
+  // found full in tables of |bucket_count| buckets. We first find a chain of
+  // displacements ending in a bucket with room, holding only the lock of the
+  // bucket we look at, and then make the moves from the last one back, each
+  // under the locks of both buckets of the element it moves, once we checked
+  // that the element is still in its bucket and the next one still has room.
+  // Returns false if the chain gets longer than kMaxDisplacements. If the
+  // buckets changed meanwhile, it gives up the chain and returns true, and
+  // the Add tries again.
+  bool Displace(size_t hash, size_t bucket_count) {
+    std::vector<Displacement> chain;
+    size_t table = 0;
+    size_t bucket_hash = hash;
+    while (true) {
+      std::optional<Displacement> next;
+      bool has_room = false;
+      if (!WithBucketLock(table, bucket_hash, bucket_count,
+                          [&](Bucket &bucket) {
+                            has_room = bucket.Size() < kSlotsPerBucket;
+                            if (!has_room) {
+                              next = VictimOf(bucket, chain);
+                            }
+                          })) {
+        return true;
+      }
+      if (has_room) {
+        break;
+      }
+      if (chain.size() == kMaxDisplacements || !next.has_value()) {
+        return false;
+      }
+      chain.push_back(*next);
+      // The displaced element's other bucket is in the other table.
+      table = 1 - table;
+      bucket_hash = next->hash;
+    }
+    for (size_t i = chain.size(); i-- > 0;) {
+      const Displacement &move = chain[i];
+      // The moves alternate between the tables, from the first.
+      size_t from = i % kTableCount;
+      bool moved = WithLocks<std::scoped_lock<StripeMutex>>(move.hash, [&] {
+        Bucket &to = BucketOf(1 - from, move.hash);
+        return bucket_count_.load() == bucket_count &&
+               to.Size() < kSlotsPerBucket &&
+               BucketOf(from, move.hash).Erase(move.elem) && to.Push(move.elem);
+      });
+      if (!moved) {
+        return true;
+      }
+    }
+    return true;
+  }
+
+  // Calls |fn| with the bucket of the element with |hash| in |table| while
+  // holding its stripe for reading, if the tables still have |bucket_count|
+  // buckets. Returns false, without calling |fn|, if they do not.
+  template <typename Fn>
+  bool WithBucketLock(size_t table, size_t hash, size_t bucket_count, Fn fn) {
+    while (true) {
+      size_t lock_count = lock_count_.load();
+      ScopedReaderLock<StripeMutex> lock(LockOf(table, hash, lock_count));
+      if (lock_count_.load() != lock_count) {
+        continue;
+      }
+      if (bucket_count_.load() != bucket_count) {
+        return false;
+      }
+      fn(BucketOf(table, hash));
+      return true;
+    }
+  }
+
+  // The element of the full |bucket| to displace next, the first from the
+  // rotating slot that is not displaced already by |chain|. Nothing moves
+  // while a chain is found, so the chain would otherwise come back to the
+  // same element whenever it comes back to a bucket, and go around a cycle
+  // of buckets until it gives up.
+  std::optional<Displacement>
+  VictimOf(Bucket &bucket, const std::vector<Displacement> &chain) {
+    size_t first = NextVictim();
+    for (size_t i = 0; i < kSlotsPerBucket; i++) {
+      T &victim = bucket.At((first + i) % kSlotsPerBucket);
+      if (std::none_of(chain.begin(), chain.end(),
+                       [&](const Displacement &move) {
+                         return move.elem == victim;
+                       })) {
+        return Displacement{victim, hash_(victim)};
+      }
+    }
+    return std::nullopt;
+  }
+
+  size_t NextVictim() {
+    return next_victim_.fetch_add(1, std::memory_order_relaxed) %
+           kSlotsPerBucket;
+  }
+
+  // Doubles the tables, unless another thread grew them since they had
+  // |bucket_count| buckets. This is the only path of Add that locks every
+  // stripe.
+  void Grow(size_t bucket_count) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    ScopedVectorLock<StripeMutex> first_locks(mutexes_[0]);
+    ScopedVectorLock<StripeMutex> second_locks(mutexes_[1]);
+    stats_.Quiesced(begin_time);
+    if (bucket_count_.load() == bucket_count) {
+      Rebuild(2 * bucket_count);
+    }
+  }
+
+  // Places |elem| into one of its buckets, displacing the elements in the way
+  // until one lands in a bucket with room. Returns false if that takes more
+  // than kMaxDisplacements moves, in which case |elem| is left holding the
+  // element that could not be placed. The caller holds all the locks.
+  bool Place(T &elem) {
+    size_t hash = hash_(elem);
+    if (BucketOf(0, hash).Push(elem) || BucketOf(1, hash).Push(elem)) {
+      return true;
+    }
+    size_t table = 0;
+    for (size_t i = 0; i < kMaxDisplacements; i++) {
+      Bucket &bucket = BucketOf(table, hash);
+      std::swap(elem, bucket.At(NextVictim()));
+      // The evicted element's other bucket is in the other table.
+      table = 1 - table;
+      hash = hash_(elem);
+      if (BucketOf(table, hash).Push(elem)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Rebuilds the tables with |bucket_count| buckets each, and keeps doubling
+  // them until every element has been placed without a failed chain, and
+  // grows the lock count with them. The caller holds all the locks.
+  void Rebuild(size_t bucket_count) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    std::vector<T> elems;
+    elems.reserve(elem_count_.Sum());
+    for (std::vector<Bucket> &table : tables_) {
+      for (Bucket &bucket : table) {
+        for (size_t i = 0; i < bucket.Size(); i++) {
+          elems.push_back(std::move(bucket.At(i)));
+        }
+      }
+    }
+    bucket_count_.store(bucket_count);
+    while (!PlaceAll(elems)) {
+      bucket_count_.store(2 * bucket_count_.load());
+    }
+    lock_count_.store(lock_policy_.TargetLockCount(bucket_count_.load(),
+                                                   lock_count_.load()));
+    stats_.Resized(begin_time);
+  }
+
+  // Places |elems| into empty tables of |bucket_count_| buckets each. Returns
+  // false if a chain failed. The caller holds all the locks.
+  bool PlaceAll(const std::vector<T> &elems) {
+    for (std::vector<Bucket> &table : tables_) {
+      table = std::vector<Bucket>(bucket_count_.load());
+    }
+    for (const T &elem : elems) {
+      T copy = elem;
+      if (!Place(copy)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif // HASH_SET_CUCKOO_H
@@ -0,0 +1,45 @@
+#ifndef HASH_SET_FLAT_H
+#define HASH_SET_FLAT_H
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "src/flat_table.h"
+#include "src/hash_set_base.h"
+
+/*
+ * The flat hash set is a sequential hash set that stores the elements inline in
+ * a single open-addressing table instead of a vector of buckets, see FlatTable
+ * for the probing scheme.
+ */
+template <typename T, typename Hash = std::hash<T>>
+class HashSetFlat : public HashSetBase<HashSetFlat<T, Hash>, T> {
+public:
+  explicit HashSetFlat(size_t capacity, Hash hash = Hash())
+      : table_(capacity, std::move(hash)) {}
+
+  // Builds the hash set of |elems| with a table sized for all of them.
+  HashSetFlat(const std::vector<T> &elems, size_t capacity, Hash hash = Hash())
+      : HashSetFlat(capacity, std::move(hash)) {
+    Reserve(elems.size());
+    for (const T &elem : elems) {
+      table_.Insert(elem);
+    }
+  }
+
+  bool Add(T elem) { return table_.Insert(std::move(elem)); }
+
+  bool Remove(T elem) { return table_.Erase(elem); }
+
+  [[nodiscard]] bool Contains(T elem) { return table_.Contains(elem); }
+
+  [[nodiscard]] size_t Size() const { return table_.Size(); }
+
+  void Reserve(size_t elem_count) { table_.Reserve(elem_count); }
+
+private:
+  FlatTable<T, Hash> table_;
+};
+
+#endif // HASH_SET_FLAT_H
@@ -0,0 +1,156 @@
+#ifndef HASH_SET_FLAT_STRIPED_H
+#define HASH_SET_FLAT_STRIPED_H
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "src/cache_aligned.h"
+#include "src/flat_table.h"
+#include "src/hash_functions.h"
+#include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/parallel_for.h"
+
+/*
+ * The flat striped hash set splits the elements into as many flat tables as
+ * there are stripes, each protected by its own mutex. Since a probe sequence
+ * of an open-addressing table may run through any slot, a stripe cannot guard
+ * a range of slots of one shared table the way it guards a set of buckets in
+ * the striped hash set. Giving each stripe its own table instead means that a
+ * table only ever grows under its own lock, so resizing never has to stop the
+ * other stripes.
+ */
+template <typename T, typename Hash = std::hash<T>>
+class HashSetFlatStriped
+    : public HashSetBase<HashSetFlatStriped<T, Hash>, T> {
+public:
+  explicit HashSetFlatStriped(size_t capacity, Hash hash = Hash())
+      : hash_(std::move(hash)), stripe_count_(capacity), elem_count_(0),
+        mutexes_(capacity) {
+    tables_.reserve(stripe_count_);
+    for (size_t i = 0; i < stripe_count_; i++) {
+      tables_.emplace_back(0, StripeHash(hash_, stripe_count_));
+    }
+  }
+
+  // Builds the hash set of |elems| with tables sized for all of them. Large
+  // sets are filled by a few threads, each inserting into the tables of some
+  // of the stripes, without taking any lock.
+  HashSetFlatStriped(const std::vector<T> &elems, size_t capacity,
+                     Hash hash = Hash())
+      : HashSetFlatStriped(capacity, std::move(hash)) {
+    Reserve(elems.size());
+    auto stripe_of = [&](size_t i) {
+      return BucketIndex(hash_(elems[i]), stripe_count_);
+    };
+    elem_count_.store(ParallelForEachPart(
+        elems.size(), stripe_count_,
+        ThreadCountFor(elems.size(), kMinElemsPerThread), stripe_of,
+        [&](size_t i) { return tables_[stripe_of(i)].Insert(elems[i]); }));
+  }
+
+  // We lock the stripe of the element, and let its table resize itself if it
+  // gets too full.
+  bool Add(T elem) {
+    size_t my_stripe = BucketIndex(hash_(elem), stripe_count_);
+    std::scoped_lock<StripeMutex> lock(mutexes_[my_stripe]);
+    if (!tables_[my_stripe].Insert(std::move(elem))) {
+      return false;
+    }
+    elem_count_.fetch_add(1);
+    return true;
+  }
+
+  bool Remove(T elem) {
+    size_t my_stripe = BucketIndex(hash_(elem), stripe_count_);
+    std::scoped_lock<StripeMutex> lock(mutexes_[my_stripe]);
+    if (!tables_[my_stripe].Erase(elem)) {
+      return false;
+    }
+    assert(elem_count_ != 0);
+    elem_count_.fetch_sub(1);
+    return true;
+  }
+
+  [[nodiscard]] bool Contains(T elem) {
+    size_t my_stripe = BucketIndex(hash_(elem), stripe_count_);
+    std::scoped_lock<StripeMutex> lock(mutexes_[my_stripe]);
+    return tables_[my_stripe].Contains(elem);
+  }
+
+  [[nodiscard]] size_t Size() const { return elem_count_.load(); }
+
+  // Grows the table of each stripe to its share of |elem_count| elements.
+  // The elements are spread over the stripes by hash, so the shares are
+  // about even.
+  void Reserve(size_t elem_count) {
+    size_t share = (elem_count + stripe_count_ - 1) / stripe_count_;
+    for (size_t i = 0; i < stripe_count_; i++) {
+      std::scoped_lock<StripeMutex> lock(mutexes_[i]);
+      tables_[i].Reserve(share);
+    }
+  }
+
+#ifdef HASH_SET_STATS
+  // The tables of the stripes resize themselves, and have no buckets, so
+  // only the lock counters are reported.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    for (const StripeMutex &mutex : mutexes_) {
+      StatsRecorder::ReportLock(mutex, stats);
+    }
+    return stats;
+  }
+#endif
+
+private:
+  // The mutexes count their acquisitions when the stats are compiled in.
+  using StripeMutex = StatsMutex<CacheAligned<std::mutex>>;
+
+  // The number of elements worth starting another thread for when a bulk
+  // build inserts them.
+  static constexpr size_t kMinElemsPerThread = 1 << 16;
+
+  // All the elements of a stripe agree on their hash modulo the stripe count,
+  // so the tables index their slots with the remaining bits of the hash. For a
+  // power-of-two stripe count, that is a shift rather than a division.
+  class StripeHash {
+  public:
+    StripeHash(Hash hash, size_t stripe_count)
+        : hash_(std::move(hash)), stripe_count_(stripe_count), shift_(0) {
+      while ((size_t{1} << shift_) < stripe_count_) {
+        shift_++;
+      }
+    }
+
+    size_t operator()(const T &elem) const {
+      if ((size_t{1} << shift_) == stripe_count_) {
+        return hash_(elem) >> shift_;
+      }
+      return hash_(elem) / stripe_count_;
+    }
+
+  private:
+    Hash hash_;
+    size_t stripe_count_;
+    size_t shift_;
+  };
+
+  Hash hash_;
+
+  // The stripe count never changes, only the tables of the stripes grow.
+  const size_t stripe_count_;
+  // The element count must be atomic, so that we can have multiple operations
+  // on separate stripes.
+  std::atomic<size_t> elem_count_;
+  std::vector<FlatTable<T, StripeHash>> tables_;
+  // A mutex for each stripe, guarding the table of that stripe, padded to a
+  // cache line of its own.
+  std::vector<StripeMutex> mutexes_;
+};
+
+#endif // HASH_SET_FLAT_STRIPED_H
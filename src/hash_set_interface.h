@@ -0,0 +1,86 @@
+#ifndef HASH_SET_INTERFACE_H
+#define HASH_SET_INTERFACE_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "src/hash_set_stats.h"
+
+// The operations of HashSetBase as virtual functions, for callers that pick
+// the hash set at run time and accept an indirect call per operation.
+template <typename T> class HashSetInterface {
+public:
+  using ValueType = T;
+
+  virtual ~HashSetInterface() = default;
+
+  virtual bool Add(T elem) = 0;
+  virtual bool Remove(T elem) = 0;
+  [[nodiscard]] virtual bool Contains(T elem) = 0;
+  [[nodiscard]] virtual size_t Size() const = 0;
+  virtual void Reserve(size_t elem_count) = 0;
+  virtual size_t AddAll(const std::vector<T> &elems) = 0;
+  virtual size_t RemoveAll(const std::vector<T> &elems) = 0;
+  [[nodiscard]] virtual std::vector<bool>
+  ContainsMany(const std::vector<T> &elems) = 0;
+#ifdef HASH_SET_STATS
+  [[nodiscard]] virtual HashSetStats Stats() = 0;
+#endif
+};
+
+// Owns a |HashSetType| and implements HashSetInterface by forwarding to it.
+// It is constructed from the constructor arguments of the hash set, since the
+// hash sets can be neither copied nor moved.
+template <typename HashSetType>
+class HashSetAdapter final
+    : public HashSetInterface<typename HashSetType::ValueType> {
+public:
+  using ValueType = typename HashSetType::ValueType;
+
+  template <typename... Args,
+            typename = std::enable_if_t<
+                std::is_constructible_v<HashSetType, Args &&...>>>
+  explicit HashSetAdapter(Args &&...args)
+      : hash_set_(std::forward<Args>(args)...) {}
+
+  bool Add(ValueType elem) override { return hash_set_.Add(std::move(elem)); }
+
+  bool Remove(ValueType elem) override {
+    return hash_set_.Remove(std::move(elem));
+  }
+
+  [[nodiscard]] bool Contains(ValueType elem) override {
+    return hash_set_.Contains(std::move(elem));
+  }
+
+  [[nodiscard]] size_t Size() const override { return hash_set_.Size(); }
+
+  void Reserve(size_t elem_count) override { hash_set_.Reserve(elem_count); }
+
+  size_t AddAll(const std::vector<ValueType> &elems) override {
+    return hash_set_.AddAll(elems);
+  }
+
+  size_t RemoveAll(const std::vector<ValueType> &elems) override {
+    return hash_set_.RemoveAll(elems);
+  }
+
+  [[nodiscard]] std::vector<bool>
+  ContainsMany(const std::vector<ValueType> &elems) override {
+    return hash_set_.ContainsMany(elems);
+  }
+
+#ifdef HASH_SET_STATS
+  [[nodiscard]] HashSetStats Stats() override { return hash_set_.Stats(); }
+#endif
+
+  // Returns the wrapped hash set, for callers that know its type.
+  HashSetType &Get() { return hash_set_; }
+
+private:
+  HashSetType hash_set_;
+};
+
+#endif // HASH_SET_INTERFACE_H
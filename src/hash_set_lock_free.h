@@ -0,0 +1,388 @@
+#ifndef HASH_SET_LOCK_FREE_H
+#define HASH_SET_LOCK_FREE_H
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "src/epoch_domain.h"
+#include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/parallel_for.h"
+
+/*
+ * The lock-free implementation follows the split-ordered list of the Art of
+ * Multiprocessor Programming (recursive split ordering). All elements live in
+ * a single lock-free linked list sorted by the bit-reversed hash of the
+ * element, where removal first marks the next pointer of a node and then
+ * unlinks it. The buckets are only shortcuts into that list: each bucket
+ * points to a sentinel node, which is inserted lazily the first time the
+ * bucket is used by recursively initialising its parent bucket. Resizing
+ * therefore just doubles the bucket count, and no element is ever moved.
+ *
+ * The bucket array is made of segments of doubling size, so that it can grow
+ * without being copied. Since C++ has no garbage collector, unlinked nodes may
+ * still be traversed by other threads, so every operation pins an epoch of
+ * |epochs_| while it walks the list, and the unlinked nodes are retired to it
+ * and freed once no pinned operation can still reach them, see EpochDomain.
+ */
+template <typename T, typename Hash = std::hash<T>>
+class HashSetLockFree : public HashSetBase<HashSetLockFree<T, Hash>, T> {
+public:
+  explicit HashSetLockFree(size_t capacity, Hash hash = Hash())
+      : hash_(std::move(hash)), bucket_count_(RoundUpToPowerOfTwo(capacity)),
+        elem_count_(0) {
+    for (std::atomic<std::atomic<Node *> *> &segment : segments_) {
+      segment.store(nullptr);
+    }
+    GetBucketSlot(0).store(new Node(SentinelKey(0)));
+  }
+
+  // No other thread may use the hash set any more, so the nodes still linked
+  // are freed right away, and |epochs_| frees the retired ones.
+  ~HashSetLockFree() {
+    Node *node = GetBucketSlot(0).load();
+    while (node != nullptr) {
+      Node *next = GetPointer(node->next_.load());
+      delete node;
+      node = next;
+    }
+    for (std::atomic<std::atomic<Node *> *> &segment : segments_) {
+      delete[] segment.load();
+    }
+  }
+
+  // Builds the hash set of |elems| with as many buckets as it would grow to.
+  // Large sets are filled by a few threads, which add disjoint slices of
+  // |elems| concurrently.
+  HashSetLockFree(const std::vector<T> &elems, size_t capacity,
+                  Hash hash = Hash())
+      : HashSetLockFree(capacity, std::move(hash)) {
+    Reserve(elems.size());
+    ParallelFor(elems.size(), ThreadCountFor(elems.size(), kMinElemsPerThread),
+                [&](size_t begin, size_t end) {
+                  for (size_t i = begin; i < end; i++) {
+                    Add(elems[i]);
+                  }
+                });
+  }
+
+  HashSetLockFree(const HashSetLockFree &) = delete;
+  HashSetLockFree &operator=(const HashSetLockFree &) = delete;
+
+  // We look for the element starting from the sentinel of its bucket, and if
+  // it is absent we link a new node in with a single compare-and-swap on the
+  // next pointer of its predecessor.
+  bool Add(T elem) {
+    size_t hash = hash_(elem);
+    size_t key = RegularKey(hash);
+    EpochDomain::Guard guard(epochs_);
+    Node *head = GetBucket(hash & (bucket_count_.load() - 1));
+    Node *prev;
+    Node *curr;
+    if (Find(head, key, &elem, &prev, &curr)) {
+      return false;
+    }
+    Node *node = new Node(key, std::move(elem));
+    if (Insert(head, node) != node) {
+      delete node;
+      return false;
+    }
+    elem_count_.fetch_add(1);
+    if (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
+    return true;
+  }
+
+  // Removing marks the next pointer of the node first, which logically
+  // deletes it, and then tries to unlink it. If unlinking fails, another
+  // traversal of the list does it for us.
+  bool Remove(T elem) {
+    size_t hash = hash_(elem);
+    size_t key = RegularKey(hash);
+    EpochDomain::Guard guard(epochs_);
+    Node *head = GetBucket(hash & (bucket_count_.load() - 1));
+    while (true) {
+      Node *prev;
+      Node *curr;
+      if (!Find(head, key, &elem, &prev, &curr)) {
+        return false;
+      }
+      uintptr_t succ = curr->next_.load();
+      if (IsMarked(succ) ||
+          !curr->next_.compare_exchange_strong(succ, succ | kMark)) {
+        continue;
+      }
+      assert(elem_count_ != 0);
+      elem_count_.fetch_sub(1);
+      uintptr_t expected = Pack(curr);
+      if (prev->next_.compare_exchange_strong(expected,
+                                              Pack(GetPointer(succ)))) {
+        Retire(curr);
+      } else {
+        Find(head, key, &elem, &prev, &curr);
+      }
+      return true;
+    }
+  }
+
+  // The contains operation never writes to shared memory, other than the
+  // epoch slot of its own thread: it walks the list from the sentinel of the
+  // bucket and ignores the deletion marks until it reaches the position of
+  // the element.
+  [[nodiscard]] bool Contains(T elem) {
+    size_t hash = hash_(elem);
+    size_t key = RegularKey(hash);
+    EpochDomain::Guard guard(epochs_);
+    Node *curr = GetBucket(hash & (bucket_count_.load() - 1));
+    while (curr != nullptr &&
+           (curr->key_ < key || (curr->key_ == key && !Matches(curr, &elem)))) {
+      curr = GetPointer(curr->next_.load());
+    }
+    return curr != nullptr && curr->key_ == key &&
+           !IsMarked(curr->next_.load());
+  }
+
+  [[nodiscard]] size_t Size() const { return elem_count_.load(); }
+
+  // Raises the bucket count to what it would grow to while |elem_count|
+  // elements were added. No element moves when the bucket count grows, so
+  // this only spares the adds the long bucket lists of a table that has not
+  // caught up with them yet.
+  void Reserve(size_t elem_count) {
+    size_t bucket_count = bucket_count_.load();
+    size_t target = bucket_count;
+    while (elem_count / target > kMaxLoadFactor) {
+      target *= 2;
+    }
+    while (bucket_count < target &&
+           !bucket_count_.compare_exchange_weak(bucket_count, target)) {
+    }
+  }
+
+#ifdef HASH_SET_STATS
+  // There are no locks, and walking the list to measure the buckets would
+  // take as long as a scan of the whole hash set, so we only report the
+  // average bucket length.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    stats_.Report(stats);
+    stats.average_bucket_length = static_cast<double>(elem_count_.load()) /
+                                  static_cast<double>(bucket_count_.load());
+    return stats;
+  }
+#endif
+
+private:
+  // Each node holds the split-order key, and the element itself unless it is
+  // a bucket sentinel. The lowest bit of next_ is the deletion mark.
+  struct Node {
+    explicit Node(size_t key) : key_(key), next_(0) {}
+    Node(size_t key, T elem) : key_(key), elem_(std::move(elem)), next_(0) {}
+
+    const size_t key_;
+    const std::optional<T> elem_;
+    std::atomic<uintptr_t> next_;
+  };
+
+  static constexpr size_t kBits = sizeof(size_t) * CHAR_BIT;
+  static constexpr size_t kMsb = size_t{1} << (kBits - 1);
+  static constexpr uintptr_t kMark = 1;
+  static constexpr size_t kMaxLoadFactor = 4;
+  // The number of elements worth starting another thread for when a bulk
+  // build adds them.
+  static constexpr size_t kMinElemsPerThread = 1 << 16;
+  static_assert(kBits == 64, "ReverseBits assumes a 64-bit size_t");
+  static_assert(alignof(Node) > 1, "the lowest bit of a Node * must be free");
+
+  Hash hash_;
+  // The segment s > 0 holds the buckets [2^(s - 1), 2^s), and the segment 0
+  // holds the bucket 0 only.
+  std::array<std::atomic<std::atomic<Node *> *>, kBits> segments_;
+  // The bucket count is always a power of two, so that the parent of a bucket
+  // is found by clearing its highest set bit.
+  std::atomic<size_t> bucket_count_;
+  // The element count must be atomic, so that we can have multiple operations
+  // on separate buckets.
+  std::atomic<size_t> elem_count_;
+  // Frees the nodes unlinked from the list once no operation can reach them.
+  EpochDomain epochs_;
+  StatsRecorder stats_;
+
+  static size_t RoundUpToPowerOfTwo(size_t capacity) {
+    size_t result = 1;
+    while (result < capacity) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  static size_t ReverseBits(size_t value) {
+    value = ((value >> 1) & 0x5555555555555555) |
+            ((value & 0x5555555555555555) << 1);
+    value = ((value >> 2) & 0x3333333333333333) |
+            ((value & 0x3333333333333333) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F0F0F0F0F) |
+            ((value & 0x0F0F0F0F0F0F0F0F) << 4);
+    value = ((value >> 8) & 0x00FF00FF00FF00FF) |
+            ((value & 0x00FF00FF00FF00FF) << 8);
+    value = ((value >> 16) & 0x0000FFFF0000FFFF) |
+            ((value & 0x0000FFFF0000FFFF) << 16);
+    return (value >> 32) | (value << 32);
+  }
+
+  // Regular keys have their lowest bit set, so that they are ordered after
+  // the sentinel of their bucket, whose key has the lowest bit cleared.
+  static size_t RegularKey(size_t hash) { return ReverseBits(hash | kMsb); }
+
+  static size_t SentinelKey(size_t bucket) { return ReverseBits(bucket); }
+
+  static size_t HighestBit(size_t value) {
+    return kBits - 1 - static_cast<size_t>(__builtin_clzl(value));
+  }
+
+  static Node *GetPointer(uintptr_t next) {
+    return reinterpret_cast<Node *>(next & ~kMark);
+  }
+
+  static bool IsMarked(uintptr_t next) { return (next & kMark) != 0; }
+
+  static uintptr_t Pack(Node *node) {
+    return reinterpret_cast<uintptr_t>(node);
+  }
+
+  // Sentinel keys are unique, so a sentinel matches as soon as the keys are
+  // equal. Regular keys of different elements collide when their hashes do.
+  static bool Matches(const Node *node, const T *elem) {
+    return elem == nullptr || *node->elem_ == *elem;
+  }
+
+  bool Policy() {
+    return elem_count_.load() / bucket_count_.load() > kMaxLoadFactor;
+  }
+
+  // Resizing never moves any element, the new buckets get their sentinels
+  // lazily. A failed compare-and-swap means another thread already resized.
+  void Resize() {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    size_t old_capacity = bucket_count_.load();
+    if (bucket_count_.compare_exchange_strong(old_capacity,
+                                              2 * old_capacity)) {
+      stats_.Resized(begin_time);
+    }
+  }
+
+  std::atomic<Node *> &GetBucketSlot(size_t bucket) {
+    size_t segment = bucket == 0 ? 0 : HighestBit(bucket) + 1;
+    size_t first = segment == 0 ? 0 : size_t{1} << (segment - 1);
+    std::atomic<Node *> *slots = segments_[segment].load();
+    if (slots == nullptr) {
+      size_t size = segment == 0 ? 1 : first;
+      std::atomic<Node *> *fresh = new std::atomic<Node *>[size]();
+      if (segments_[segment].compare_exchange_strong(slots, fresh)) {
+        slots = fresh;
+      } else {
+        delete[] fresh;
+      }
+    }
+    return slots[bucket - first];
+  }
+
+  Node *GetBucket(size_t bucket) {
+    Node *sentinel = GetBucketSlot(bucket).load();
+    if (sentinel == nullptr) {
+      sentinel = InitializeBucket(bucket);
+    }
+    return sentinel;
+  }
+
+  // The parent of a bucket is the bucket it was split from, so its sentinel
+  // precedes ours in the list. If another thread inserted our sentinel first,
+  // we use theirs.
+  Node *InitializeBucket(size_t bucket) {
+    Node *parent = GetBucket(bucket & ~(size_t{1} << HighestBit(bucket)));
+    Node *node = new Node(SentinelKey(bucket));
+    Node *sentinel = Insert(parent, node);
+    if (sentinel != node) {
+      delete node;
+    }
+    GetBucketSlot(bucket).store(sentinel);
+    return sentinel;
+  }
+
+  /*
+   * Finds the window (prev, curr) such that curr is the node holding |elem|
+   * with split-order key |key| (or the sentinel with key |key| when |elem| is
+   * null), or the node it should be inserted before. On the way we unlink
+   * every marked node we meet, and restart from |head| if a compare-and-swap
+   * fails because the list changed under us.
+   */
+  bool Find(Node *head, size_t key, const T *elem, Node **prev_out,
+            Node **curr_out) {
+    while (true) {
+      Node *prev = head;
+      Node *curr = GetPointer(prev->next_.load());
+      bool restart = false;
+      while (!restart) {
+        if (curr == nullptr) {
+          *prev_out = prev;
+          *curr_out = curr;
+          return false;
+        }
+        uintptr_t succ = curr->next_.load();
+        if (IsMarked(succ)) {
+          uintptr_t expected = Pack(curr);
+          if (prev->next_.compare_exchange_strong(expected,
+                                                  Pack(GetPointer(succ)))) {
+            Retire(curr);
+            curr = GetPointer(succ);
+          } else {
+            restart = true;
+          }
+          continue;
+        }
+        if (curr->key_ > key || (curr->key_ == key && Matches(curr, elem))) {
+          *prev_out = prev;
+          *curr_out = curr;
+          return curr->key_ == key;
+        }
+        prev = curr;
+        curr = GetPointer(succ);
+      }
+    }
+  }
+
+  // Links |node| into the list after |head|, and returns it, unless a node
+  // with the same contents is already present, in which case that node is
+  // returned instead.
+  Node *Insert(Node *head, Node *node) {
+    const T *elem = node->elem_.has_value() ? &*node->elem_ : nullptr;
+    while (true) {
+      Node *prev;
+      Node *curr;
+      if (Find(head, node->key_, elem, &prev, &curr)) {
+        return curr;
+      }
+      node->next_.store(Pack(curr));
+      uintptr_t expected = Pack(curr);
+      if (prev->next_.compare_exchange_strong(expected, Pack(node))) {
+        return node;
+      }
+    }
+  }
+
+  // The caller has pinned an epoch and unlinked |node|, which is retired to
+  // the list of the calling thread, so that removals do not contend on a
+  // shared list head.
+  void Retire(Node *node) { epochs_.Retire(node); }
+};
+
+#endif // HASH_SET_LOCK_FREE_H
@@ -0,0 +1,117 @@
+#ifndef HASH_SET_MAPPED_H
+#define HASH_SET_MAPPED_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/snapshot_image.h"
+
+/*
+ * A front-end that answers lookups from a mapped SnapshotImage right away,
+ * while a background thread builds a |HashSetType| of its elements with the
+ * bulk constructor. Once that hash set is built it is promoted: every
+ * operation is forwarded to it from then on. Add, Remove and Reserve wait for
+ * the promotion, since the image is read-only, but lookups never do.
+ *
+ * The elements of the image were distinct when it was written, so the bulk
+ * build never looks for duplicates across the image. The image stays mapped
+ * until the front-end is destroyed, since lookups that started before the
+ * promotion may still be reading it, but its pages are only read from the
+ * file, and the kernel may drop them again once the promoted set is used.
+ */
+template <typename HashSetType,
+          typename Hash = std::hash<typename HashSetType::ValueType>>
+class HashSetMapped
+    : public HashSetBase<HashSetMapped<HashSetType, Hash>,
+                         typename HashSetType::ValueType> {
+public:
+  using ValueType = typename HashSetType::ValueType;
+  using Image = SnapshotImage<ValueType, Hash>;
+
+  // Promotes |image| into the hash set constructed from its elements and
+  // |args|, e.g. the initial capacity.
+  template <typename... Args,
+            typename = std::enable_if_t<std::is_constructible_v<
+                HashSetType, const std::vector<ValueType> &, const Args &...>>>
+  explicit HashSetMapped(std::unique_ptr<const Image> image,
+                         const Args &...args)
+      : image_(std::move(image)), promoted_(nullptr) {
+    promotion_ = std::thread([this, args...] {
+      std::vector<ValueType> elems(image_->begin(), image_->end());
+      auto *hash_set = new HashSetType(elems, args...);
+      {
+        std::lock_guard<std::mutex> lock(promotion_mutex_);
+        promoted_.store(hash_set);
+      }
+      promotion_done_.notify_all();
+    });
+  }
+
+  ~HashSetMapped() {
+    promotion_.join();
+    delete promoted_.load();
+  }
+
+  HashSetMapped(const HashSetMapped &) = delete;
+  HashSetMapped &operator=(const HashSetMapped &) = delete;
+
+  bool Add(ValueType elem) { return Promoted().Add(std::move(elem)); }
+
+  bool Remove(ValueType elem) { return Promoted().Remove(std::move(elem)); }
+
+  [[nodiscard]] bool Contains(ValueType elem) {
+    HashSetType *hash_set = promoted_.load();
+    if (hash_set != nullptr) {
+      return hash_set->Contains(std::move(elem));
+    }
+    return image_->Contains(elem);
+  }
+
+  [[nodiscard]] size_t Size() const {
+    const HashSetType *hash_set = promoted_.load();
+    return hash_set != nullptr ? hash_set->Size() : image_->Size();
+  }
+
+  void Reserve(size_t elem_count) { Promoted().Reserve(elem_count); }
+
+  // Whether the operations are forwarded to the promoted hash set yet.
+  [[nodiscard]] bool IsPromoted() const { return promoted_.load() != nullptr; }
+
+#ifdef HASH_SET_STATS
+  // The counters of the promoted hash set, once there is one.
+  [[nodiscard]] HashSetStats Stats() { return Promoted().Stats(); }
+#endif
+
+private:
+  std::unique_ptr<const Image> image_;
+  // Null until the promotion, and only set once.
+  std::atomic<HashSetType *> promoted_;
+  std::mutex promotion_mutex_;
+  std::condition_variable promotion_done_;
+  // Started in the body of the constructor, once the members it uses are
+  // constructed.
+  std::thread promotion_;
+
+  // Returns the promoted hash set, waiting for it if need be.
+  HashSetType &Promoted() {
+    HashSetType *hash_set = promoted_.load();
+    if (hash_set == nullptr) {
+      std::unique_lock<std::mutex> lock(promotion_mutex_);
+      promotion_done_.wait(
+          lock, [&] { return (hash_set = promoted_.load()) != nullptr; });
+    }
+    return *hash_set;
+  }
+};
+
+#endif // HASH_SET_MAPPED_H
@@ -0,0 +1,159 @@
+#ifndef HASH_SET_NUMA_H
+#define HASH_SET_NUMA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "src/hash_functions.h"
+#include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/numa_topology.h"
+
+/*
+ * A front-end that splits the elements over one |HashSetType| per NUMA node,
+ * by hash, and forwards each operation to the shard of its element. Each
+ * shard is constructed by a thread pinned to its node, so that its table,
+ * locks and counters are first touched, and therefore allocated, there,
+ * rather than all on the node of the thread constructing the front-end.
+ *
+ * The memory a shard allocates later, when it grows, is touched first by
+ * whichever thread makes it grow, so for it to stay on the node of the shard,
+ * |HashSetType| should allocate through a NodeAllocator of node_memory.h,
+ * which binds its memory to the node it was constructed on. A shard
+ * constructs its allocators along with itself, on its node. Reserve runs on
+ * the node of each shard in any case.
+ *
+ * An operation on the shard of another node is still a remote access, so
+ * the front-end spreads the memory traffic over both nodes rather than
+ * removing it. On a machine with a single node there is one shard and the
+ * front-end only adds the forwarding.
+ */
+template <typename HashSetType,
+          typename ShardHash = std::hash<typename HashSetType::ValueType>>
+class HashSetNuma
+    : public HashSetBase<HashSetNuma<HashSetType, ShardHash>,
+                         typename HashSetType::ValueType> {
+public:
+  using ValueType = typename HashSetType::ValueType;
+
+  // Every shard is constructed from |args|, e.g. the initial capacity.
+  template <typename... Args,
+            typename = std::enable_if_t<
+                std::is_constructible_v<HashSetType, const Args &...>>>
+  explicit HashSetNuma(const Args &...args)
+      : shards_(NumaTopology::Get().NodeCount()) {
+    OnEachNode([&](size_t node) {
+      shards_[node] = std::make_unique<HashSetType>(args...);
+    });
+  }
+
+  // Builds each shard from its share of |elems| and |args|, with the bulk
+  // constructor of |HashSetType|. The elements are split by shard first.
+  template <typename... Args,
+            typename = std::enable_if_t<std::is_constructible_v<
+                HashSetType, const std::vector<ValueType> &, const Args &...>>>
+  explicit HashSetNuma(const std::vector<ValueType> &elems,
+                       const Args &...args)
+      : shards_(NumaTopology::Get().NodeCount()) {
+    std::vector<std::vector<ValueType>> shares(shards_.size());
+    for (const ValueType &elem : elems) {
+      shares[ShardIndexOf(elem)].push_back(elem);
+    }
+    OnEachNode([&](size_t node) {
+      shards_[node] = std::make_unique<HashSetType>(shares[node], args...);
+    });
+  }
+
+  bool Add(ValueType elem) { return ShardOf(elem).Add(std::move(elem)); }
+
+  bool Remove(ValueType elem) {
+    return ShardOf(elem).Remove(std::move(elem));
+  }
+
+  [[nodiscard]] bool Contains(ValueType elem) {
+    return ShardOf(elem).Contains(std::move(elem));
+  }
+
+  [[nodiscard]] size_t Size() const {
+    size_t size = 0;
+    for (const std::unique_ptr<HashSetType> &shard : shards_) {
+      size += shard->Size();
+    }
+    return size;
+  }
+
+  // Reserves each shard for its share of |elem_count| elements, on the node
+  // of the shard, so that the table it makes is first touched there.
+  void Reserve(size_t elem_count) {
+    size_t share = (elem_count + shards_.size() - 1) / shards_.size();
+    OnEachNode([&](size_t node) { shards_[node]->Reserve(share); });
+  }
+
+#ifdef HASH_SET_STATS
+  // The counters of the shards added up, with the locks of shard 0 first,
+  // then those of shard 1, etc. The average bucket length is that of the
+  // shards, which hold about as many elements each.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    for (const std::unique_ptr<HashSetType> &shard : shards_) {
+      HashSetStats shard_stats = shard->Stats();
+      stats.lock_acquisitions.insert(stats.lock_acquisitions.end(),
+                                     shard_stats.lock_acquisitions.begin(),
+                                     shard_stats.lock_acquisitions.end());
+      stats.contended_acquisitions.insert(
+          stats.contended_acquisitions.end(),
+          shard_stats.contended_acquisitions.begin(),
+          shard_stats.contended_acquisitions.end());
+      stats.total_lock_acquisitions += shard_stats.total_lock_acquisitions;
+      stats.total_contended_acquisitions +=
+          shard_stats.total_contended_acquisitions;
+      stats.policy_triggers += shard_stats.policy_triggers;
+      stats.resize_count += shard_stats.resize_count;
+      stats.resize_time += shard_stats.resize_time;
+      stats.quiesce_count += shard_stats.quiesce_count;
+      stats.quiesce_time += shard_stats.quiesce_time;
+      stats.max_bucket_length =
+          std::max(stats.max_bucket_length, shard_stats.max_bucket_length);
+      stats.average_bucket_length += shard_stats.average_bucket_length /
+                                     static_cast<double>(shards_.size());
+    }
+    return stats;
+  }
+#endif
+
+private:
+  ShardHash shard_hash_;
+  // The shards are never moved, and each is allocated by the thread that
+  // constructed it, on its node.
+  std::vector<std::unique_ptr<HashSetType>> shards_;
+
+  // The shards usually hash their elements to buckets with the same hash
+  // function, and by its low bits, so we pick the shard from the high bits of
+  // the mixed hash, which leaves each shard the use of all of its buckets.
+  size_t ShardIndexOf(const ValueType &elem) const {
+    size_t hash = MixHash(shard_hash_(elem)) >> 32;
+    return BucketIndex(hash, shards_.size());
+  }
+
+  HashSetType &ShardOf(const ValueType &elem) {
+    return *shards_[ShardIndexOf(elem)];
+  }
+
+  // Calls |fn| with each node, one at a time, on a thread pinned to it.
+  template <typename Fn> void OnEachNode(const Fn &fn) {
+    const NumaTopology &topology = NumaTopology::Get();
+    for (size_t node = 0; node < shards_.size(); node++) {
+      std::thread([&, node] {
+        PinThreadToCpus(topology.CpusOf(node));
+        fn(node);
+      }).join();
+    }
+  }
+};
+
+#endif // HASH_SET_NUMA_H
@@ -5,15 +5,28 @@
 #include <atomic>
 #include <cassert>
 #include <functional>
+#include <limits>
 #include <mutex>
+#include <numeric>
 #include <shared_mutex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "src/cache_aligned.h"
+#include "src/epoch_domain.h"
+#include "src/hash_functions.h"
 #include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/parallel_for.h"
+#include "src/part_groups.h"
+#include "src/resize_mode.h"
+#include "src/resize_policy.h"
 #include "src/scoped_vector_lock.h"
+#include "src/sharded_counter.h"
+#include "src/stripe_scan.h"
 
 /*
  * The refinable hash set implemented mainly follows the Art of Multiprocessor
@@ -25,154 +38,897 @@
  * not have IsLocked function on mutexes, we just get the ScopedLock for every
  * mutex on the mutex vector to ensure that no thread has any of the mutexes
  * allowing for the mutex vector to be resized safely.
+ *
+ * Lookups take no locks at all. The buckets are copied on write: Add and
+ * Remove build a new bucket under the mutex of the bucket and publish it with
+ * a single pointer store, and a resize publishes new tables the same way.
+ * A lookup pins an epoch of |epochs_| and reads whichever bucket is published,
+ * and the buckets and tables that are replaced are only freed once no pinned
+ * lookup can still be reading them, see EpochDomain.
+ *
+ * Past the lock cap of its ResizePolicy, the table keeps growing but the mutex
+ * vector does not, and each mutex guards the buckets congruent to it.
+ *
+ * In the incremental resize mode, the mutex count divides the smaller of the
+ * bucket counts of the old and new tables while the elements are migrated,
+ * so that the mutex of an old bucket also guards every new bucket its
+ * elements move to, whether the table grows or shrinks. Each operation then
+ * migrates the old bucket of its element before using the new table.
  */
-template <typename T> class HashSetRefinable : public HashSetBase<T> {
+template <typename T, typename Hash = std::hash<T>,
+          typename Mutex = CacheAligned<std::mutex>>
+class HashSetRefinable
+    : public HashSetBase<HashSetRefinable<T, Hash, Mutex>, T> {
 public:
-  explicit HashSetRefinable(size_t capacity)
-      : bucket_count_(capacity), elem_count_(0) {
-    table_.resize(bucket_count_.load());
-    mutexes_ = std::vector<std::mutex>(bucket_count_.load());
-    for (size_t i = 0; i < bucket_count_.load(); i++) {
-      table_[i] = std::vector<T>();
+  explicit HashSetRefinable(size_t capacity,
+                            ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                            ResizePolicy resize_policy = ResizePolicy(),
+                            Hash hash = Hash())
+      : hash_(std::move(hash)), tables_(new Tables(capacity, 0)),
+        bucket_count_(capacity), min_bucket_count_(capacity),
+        elem_count_(capacity), resize_mode_(resize_mode),
+        resize_policy_(resize_policy),
+        max_mutex_count_(resize_policy_.TargetLockCount(
+            std::numeric_limits<size_t>::max(), capacity)) {
+    mutexes_ = std::vector<StripeMutex>(bucket_count_.load());
+  }
+
+  // Builds the hash set of |elems| with a table sized for all of them. The
+  // buckets are filled in place and published once each, and large sets are
+  // filled by a few threads, each building some of the buckets.
+  HashSetRefinable(const std::vector<T> &elems, size_t capacity,
+                   ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                   ResizePolicy resize_policy = ResizePolicy(),
+                   Hash hash = Hash())
+      : HashSetRefinable(capacity, resize_mode, resize_policy,
+                         std::move(hash)) {
+    Reserve(elems.size());
+    Table &table = tables_.load()->current;
+    size_t bucket_count = table.BucketCount();
+    size_t thread_count = ThreadCountFor(elems.size(), kMinElemsPerThread);
+    std::vector<Bucket> buckets(bucket_count);
+    std::vector<size_t> hashes(elems.size());
+    ParallelFor(elems.size(), thread_count, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        hashes[i] = hash_(elems[i]);
+      }
+    });
+    auto bucket_of = [&](size_t i) {
+      return BucketIndex(hashes[i], bucket_count);
+    };
+    ParallelForEachPart(
+        elems.size(), bucket_count, thread_count, bucket_of, [&](size_t i) {
+          Bucket &bucket = buckets[bucket_of(i)];
+          if (std::find(bucket.begin(), bucket.end(), elems[i]) !=
+              bucket.end()) {
+            return false;
+          }
+          bucket.push_back(elems[i]);
+          elem_count_.Add(elem_count_.ShardOf(hashes[i]));
+          return true;
+        });
+    ParallelFor(bucket_count, thread_count, [&](size_t begin, size_t end) {
+      Publish(begin, end, bucket_count, buckets, table);
+    });
+  }
+
+  // No other thread may use the hash set any more, so the buckets that are
+  // still published are freed right away, and |epochs_| frees the others.
+  ~HashSetRefinable() {
+    Tables *tables = tables_.load();
+    for (Table *table : {&tables->current, &tables->old}) {
+      for (std::atomic<const Bucket *> &slot : table->buckets) {
+        delete slot.load();
+      }
     }
+    delete tables;
   }
 
+  HashSetRefinable(const HashSetRefinable &) = delete;
+  HashSetRefinable &operator=(const HashSetRefinable &) = delete;
+
   // When adding an element we use our custom scoped lock to acquire the correct
   // mutex for this bucket so no other operations can be made on it at the same
-  // time then we resize if the policy function returns true.
-  bool Add(T elem) final {
-    {
-      CustomScopedLock customScopedLock(this, elem);
-      size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-      if (ContainsNoLock(elem, my_bucket)) {
-        return false;
+  // time then we resize if the policy function returns true. The element is
+  // hashed once, and an rvalue is moved into its bucket.
+  bool Add(const T &elem) { return AddHashed(elem, hash_(elem)); }
+
+  bool Add(T &&elem) {
+    size_t hash = hash_(elem);
+    return AddHashed(std::move(elem), hash);
+  }
+
+  // Adds the element constructed from |args|. As in the standard sets, the
+  // element is constructed before it is looked up.
+  template <typename... Args> bool Emplace(Args &&...args) {
+    return Add(T(std::forward<Args>(args)...));
+  }
+
+  // When removing an element we use our custom scoped lock to acquire the
+  // correct mutex for this bucket so no other operations can be made on it at
+  // the same time, then we shrink if the policy function returns true.
+  bool Remove(const T &elem) { return RemoveHashed(elem, hash_(elem)); }
+
+  // With a transparent Hash, see IsTransparent, elements can be removed and
+  // looked up by any key that Hash hashes and that compares equal to them,
+  // without constructing an element.
+  template <typename K,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, K>>
+  bool Remove(const K &key) {
+    return RemoveHashed(key, hash_(key));
+  }
+
+  // When checking for an element we only pin an epoch, so that the buckets we
+  // read are not freed under us.
+  [[nodiscard]] bool Contains(const T &elem) {
+    EpochDomain::Guard guard(epochs_);
+    return ContainsPinned(elem, hash_(elem));
+  }
+
+  template <typename K,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, K>>
+  [[nodiscard]] bool Contains(const K &key) {
+    EpochDomain::Guard guard(epochs_);
+    return ContainsPinned(key, hash_(key));
+  }
+
+  // The batch operations take the mutex of each bucket, and publish each
+  // bucket they change, once per slice of the batch, see EditEachBucketOnce,
+  // and only check the policy once per batch. AddAll grows the table for the
+  // whole batch before it takes any lock, so that the buckets stay within the
+  // load factor while the batch fills them.
+  size_t AddAll(const std::vector<T> &elems) {
+    GrowFor(Size() + elems.size());
+    size_t added = 0;
+    EditEachBucketOnce(elems, [&](const Bucket *bucket, auto copy, size_t i,
+                                  size_t hash) {
+      if (BucketFind(bucket, elems[i]) != nullptr) {
+        return;
       }
-      table_[my_bucket].push_back(elem);
-      elem_count_.fetch_add(1);
+      copy().push_back(elems[i]);
+      elem_count_.Add(elem_count_.ShardOf(hash));
+      added++;
+    });
+    while (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
     }
-    if (Policy()) {
+    return added;
+  }
+
+  // The order of a bucket does not matter, so the last element of the copy
+  // fills the hole of an element removed.
+  size_t RemoveAll(const std::vector<T> &elems) {
+    size_t removed = 0;
+    EditEachBucketOnce(elems, [&](const Bucket *bucket, auto copy, size_t i,
+                                  size_t hash) {
+      if (BucketFind(bucket, elems[i]) == nullptr) {
+        return;
+      }
+      Bucket &edited = copy();
+      auto it = std::find(edited.begin(), edited.end(), elems[i]);
+      size_t shard = elem_count_.ShardOf(hash);
+      assert(elem_count_.Get(shard) != 0);
+      if (it != edited.end() - 1) {
+        *it = std::move(edited.back());
+      }
+      edited.pop_back();
+      elem_count_.Sub(shard);
+      removed++;
+    });
+    while (Policy()) {
+      stats_.PolicyTriggered();
       Resize();
     }
-    return true;
+    return removed;
   }
 
-  // When removing an element we use our custom scoped lock to acquire the
-  // correct mutex for this bucket so no other operations can be made on it at
-  // the same time.
-  bool Remove(T elem) final {
-    CustomScopedLock customScopedLock(this, elem);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-    if (!ContainsNoLock(elem, my_bucket)) {
-      return false;
+  // The lookups of a batch share a single pinned epoch.
+  [[nodiscard]] std::vector<bool>
+  ContainsMany(const std::vector<T> &elems) {
+    std::vector<bool> results(elems.size());
+    EpochDomain::Guard guard(epochs_);
+    for (size_t i = 0; i < elems.size(); i++) {
+      results[i] = ContainsPinned(elems[i], hash_(elems[i]));
     }
-    assert(elem_count_ != 0);
-    table_[my_bucket].erase(
-        std::find(table_[my_bucket].begin(), table_[my_bucket].end(), elem));
-    elem_count_.fetch_sub(1);
-    return true;
+    return results;
   }
-  // When checking for an element we use our custom scoped lock to acquire the
-  // correct mutex for this bucket.
-  [[nodiscard]] bool Contains(T elem) final {
-    CustomScopedLock customScopedLock(this, elem);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-    bool res = ContainsNoLock(elem, my_bucket);
-    return res;
+
+  [[nodiscard]] size_t Size() const { return elem_count_.Sum(); }
+
+  // Grows the table, in a single resize, to the size it would grow to while
+  // |elem_count| elements were added, and keeps it from shrinking below that
+  // size.
+  void Reserve(size_t elem_count) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    std::lock_guard<std::shared_mutex> writer_lock(resizing_mutex_);
+    Quiesce();
+    size_t min_bucket_count =
+        resize_policy_.BucketCountFor(elem_count, min_bucket_count_.load());
+    min_bucket_count_.store(min_bucket_count);
+    if (min_bucket_count > bucket_count_.load()) {
+      ResizeTo(min_bucket_count, begin_time);
+    }
   }
 
-  [[nodiscard]] size_t Size() const final { return elem_count_.load(); }
+  // Calls |fn| on every element, holding a single bucket mutex at a time. The
+  // elements the mutex guards are copied under it and |fn| is called once it
+  // is released, so that |fn| may use the hash set. The iteration is weakly
+  // consistent, see StripeScan: it visits the elements present throughout
+  // once, and those added or removed meanwhile at most once. Resizes may run
+  // between two mutexes.
+  template <typename Fn> void ForEach(Fn fn) {
+    size_t mutex_count = MutexCount();
+    StripeScan scan(max_mutex_count_, mutex_count, 0, mutex_count);
+    ScanStripes(scan, fn);
+  }
+
+  // The same scan split over |thread_count| threads, each given a range of
+  // the mutexes, which calls |fn(thread, elem)| on the elements they guard,
+  // with |thread| its index in [0, thread_count). Calls from the same thread
+  // are never concurrent, so that |fn| can aggregate into per-thread slots
+  // without synchronization.
+  template <typename Fn> void ParallelForEach(size_t thread_count, Fn fn) {
+    size_t mutex_count = MutexCount();
+    thread_count = std::clamp<size_t>(thread_count, 1, mutex_count);
+    ParallelFor(thread_count, thread_count, [&](size_t begin, size_t end) {
+      for (size_t thread = begin; thread < end; thread++) {
+        StripeScan scan(max_mutex_count_, mutex_count,
+                        thread * mutex_count / thread_count,
+                        (thread + 1) * mutex_count / thread_count);
+        ScanStripes(scan, [&](const T &elem) { fn(thread, elem); });
+      }
+    });
+  }
+
+  // Copies every element, in no particular order, with the other threads
+  // quiesced as for a resize, so that the copy is the hash set as it was at a
+  // single point in time. Lookups go on meanwhile. See WriteSnapshot in
+  // snapshot_image.h.
+  [[nodiscard]] std::vector<T> Snapshot() {
+    std::lock_guard<std::shared_mutex> writer_lock(resizing_mutex_);
+    Quiesce();
+    std::vector<T> elems;
+    elems.reserve(elem_count_.Sum());
+    Tables *tables = tables_.load();
+    for (Table *table : {&tables->current, &tables->old}) {
+      for (std::atomic<const Bucket *> &slot : table->buckets) {
+        const Bucket *bucket = slot.load();
+        if (bucket != nullptr) {
+          elems.insert(elems.end(), bucket->begin(), bucket->end());
+        }
+      }
+    }
+    return elems;
+  }
+
+#ifdef HASH_SET_STATS
+  // We stop the other threads like a resize does, but read the lock counters
+  // before quiescing, so that they do not include our own acquisitions.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    std::lock_guard<std::shared_mutex> writer_lock(resizing_mutex_);
+    for (const StripeMutex &mutex : mutexes_) {
+      StatsRecorder::ReportLock(mutex, stats);
+    }
+    stats_.Report(stats);
+    Quiesce();
+    Tables *tables = tables_.load();
+    for (Table *table : {&tables->current, &tables->old}) {
+      for (std::atomic<const Bucket *> &slot : table->buckets) {
+        const Bucket *bucket = slot.load();
+        if (bucket != nullptr) {
+          stats.max_bucket_length =
+              std::max(stats.max_bucket_length, bucket->size());
+        }
+      }
+    }
+    stats.average_bucket_length = static_cast<double>(elem_count_.Sum()) /
+                                  static_cast<double>(bucket_count_.load());
+    return stats;
+  }
+#endif
 
 private:
-  std::vector<std::vector<T>> table_;
+  // The hash map of hash_map_refinable.h stores its entries in a hash set, and
+  // finds and replaces them under the bucket mutexes of the set.
+  template <typename, typename, typename, typename>
+  friend class HashMapRefinable;
+
+  // The mutexes count their acquisitions when the stats are compiled in.
+  using StripeMutex = StatsMutex<Mutex>;
+
+  // A bucket is never modified once it is published, and an empty bucket is
+  // published as a null pointer.
+  using Bucket = std::vector<T>;
+
+  struct Table {
+    explicit Table(size_t bucket_count) : buckets(bucket_count) {
+      for (std::atomic<const Bucket *> &slot : buckets) {
+        slot.store(nullptr);
+      }
+    }
+
+    size_t BucketCount() const { return buckets.size(); }
+
+    std::vector<std::atomic<const Bucket *>> buckets;
+  };
+
+  // The table and, during an incremental resize, the old table the elements
+  // are migrated from, which has no buckets otherwise. A resize replaces both
+  // at once. The buckets are owned by whichever tables publish them.
+  struct Tables {
+    Tables(size_t bucket_count, size_t old_bucket_count)
+        : current(bucket_count), old(old_bucket_count) {}
+
+    Table current;
+    Table old;
+  };
+
+  Hash hash_;
+  // Only replaced while the other threads are quiesced, but read by lookups
+  // at any time.
+  std::atomic<Tables *> tables_;
   // We ensure that the element count is right by making it an atomic variable.
   std::atomic<size_t> bucket_count_;
-  // The element count must be atomic, so that we can have multiple operations
-  // on separate buckets.
-  std::atomic<size_t> elem_count_;
-  // A vector of mutexes for each bucket, which gets resized together with the
-  // buckets vector.
-  std::vector<std::mutex> mutexes_;
+  // The table never shrinks below its initial or reserved bucket count. It
+  // only changes while the other threads are quiesced.
+  std::atomic<size_t> min_bucket_count_;
+  // The element count is sharded by hash, so that operations on separate
+  // buckets mostly update separate cache lines.
+  ShardedCounter elem_count_;
+  // A vector of mutexes for each bucket, up to the lock cap of the resize
+  // policy, which gets resized together with the buckets vector. The mutex
+  // count always divides the bucket count. By default each mutex is padded to
+  // a cache line. During an incremental resize, the bucket count of the old
+  // table is a multiple of the mutex count, so the mutex of an element guards
+  // its old bucket.
+  std::vector<StripeMutex> mutexes_;
   // We use a shared lock for resizing, so we are able to allow threads that are
   // not resizing to be able to share the mutex.
   std::shared_mutex resizing_mutex_;
+  const ResizeMode resize_mode_;
+  const ResizePolicy resize_policy_;
+  // The largest mutex count the resize policy allows, which every mutex
+  // count divides.
+  const size_t max_mutex_count_;
+  EpochDomain epochs_;
+  StatsRecorder stats_;
+
+  // The number of elements worth starting another thread for when a
+  // stop-the-world resize rehashes them, or a bulk build adds them.
+  static constexpr size_t kMinElemsPerThread = 1 << 16;
+  // The number of elements of a batch whose mutexes are taken together, as in
+  // HashSetStriped. Resizes may also run between two slices.
+  static constexpr size_t kBatchSliceSize = 1024;
+
+  // Add and Remove once |key| is hashed to |hash|.
+  template <typename U> bool AddHashed(U &&elem, size_t hash) {
+    {
+      CustomScopedLock customScopedLock(this, hash);
+      if (!AddNoLock(std::forward<U>(elem), hash)) {
+        return false;
+      }
+    }
+    ResizeIfDue(hash);
+    return true;
+  }
+
+  template <typename K> bool RemoveHashed(const K &key, size_t hash) {
+    {
+      CustomScopedLock customScopedLock(this, hash);
+      if (!RemoveNoLock(key, hash)) {
+        return false;
+      }
+    }
+    ResizeIfDue(hash);
+    return true;
+  }
+
+  // Resizes the table if the policy says so, once an operation on the
+  // element with |hash| changed the element count. The caller holds no mutex.
+  void ResizeIfDue(size_t hash) {
+    if (ShardPolicy(hash) && Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
+  }
+
+  // Grows the table, in a single resize, to the size it would grow to while
+  // the element count reached |elem_count|. Unlike Reserve, it lets the table
+  // shrink back below that size.
+  void GrowFor(size_t elem_count) {
+    size_t bucket_count = bucket_count_.load();
+    if (resize_policy_.BucketCountFor(elem_count, bucket_count) ==
+        bucket_count) {
+      return;
+    }
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    std::lock_guard<std::shared_mutex> writer_lock(resizing_mutex_);
+    Quiesce();
+    bucket_count = bucket_count_.load();
+    size_t new_capacity =
+        resize_policy_.BucketCountFor(elem_count, bucket_count);
+    if (new_capacity != bucket_count) {
+      ResizeTo(new_capacity, begin_time);
+    }
+  }
+
+  // Returns the element of |bucket| equal to |key|, or null.
+  template <typename K>
+  static const T *BucketFind(const Bucket *bucket, const K &key) {
+    if (bucket == nullptr) {
+      return nullptr;
+    }
+    auto it = std::find(bucket->begin(), bucket->end(), key);
+    return it != bucket->end() ? &*it : nullptr;
+  }
+
+  // The caller has pinned an epoch, which keeps the element returned from
+  // being freed until it is unpinned. A migration publishes the new buckets
+  // of an old bucket before it empties the old bucket, so looking at the old
+  // bucket first means we cannot miss an element that is being migrated.
+  template <typename K> const T *FindPinned(const K &key, size_t hash) {
+    const Tables *tables = tables_.load();
+    size_t old_bucket_count = tables->old.BucketCount();
+    if (old_bucket_count != 0) {
+      size_t old_bucket = BucketIndex(hash, old_bucket_count);
+      const T *elem = BucketFind(tables->old.buckets[old_bucket].load(), key);
+      if (elem != nullptr) {
+        return elem;
+      }
+    }
+    size_t my_bucket = BucketIndex(hash, tables->current.BucketCount());
+    return BucketFind(tables->current.buckets[my_bucket].load(), key);
+  }
+
+  template <typename K> bool ContainsPinned(const K &key, size_t hash) {
+    return FindPinned(key, hash) != nullptr;
+  }
+
+  // The caller holds the mutex of the element with |hash|. Migrates the old
+  // bucket of the element, and returns the slot of its bucket in the current
+  // table, in which the caller may publish a new bucket.
+  std::atomic<const Bucket *> &SlotNoLock(size_t hash) {
+    Tables &tables = *tables_.load();
+    Migrate(tables, hash);
+    size_t my_bucket = BucketIndex(hash, tables.current.BucketCount());
+    return tables.current.buckets[my_bucket];
+  }
+
+  // The caller holds the mutex of |elem|, whose hash is |hash|, and we count
+  // the element in its shard.
+  template <typename U> bool AddNoLock(U &&elem, size_t hash) {
+    std::atomic<const Bucket *> &slot = SlotNoLock(hash);
+    const Bucket *bucket = slot.load();
+    if (BucketFind(bucket, elem) != nullptr) {
+      return false;
+    }
+    Bucket *copy = CopyOf(bucket, 1);
+    copy->push_back(std::forward<U>(elem));
+    Publish(slot, copy);
+    elem_count_.Add(elem_count_.ShardOf(hash));
+    return true;
+  }
+
+  template <typename K> bool RemoveNoLock(const K &key, size_t hash) {
+    std::atomic<const Bucket *> &slot = SlotNoLock(hash);
+    const Bucket *bucket = slot.load();
+    if (bucket == nullptr) {
+      return false;
+    }
+    auto it = std::find(bucket->begin(), bucket->end(), key);
+    if (it == bucket->end()) {
+      return false;
+    }
+    size_t shard = elem_count_.ShardOf(hash);
+    assert(elem_count_.Get(shard) != 0);
+    // The copy is built without the element, rather than copied whole and
+    // then shifted down over it. A bucket of one element is just unpublished.
+    Bucket *copy = nullptr;
+    if (bucket->size() > 1) {
+      copy = new Bucket();
+      copy->reserve(bucket->size() - 1);
+      copy->insert(copy->end(), bucket->begin(), it);
+      copy->insert(copy->end(), it + 1, bucket->end());
+    }
+    Publish(slot, copy);
+    elem_count_.Sub(shard);
+    return true;
+  }
+
+  // Returns a copy of |bucket|, with room for |extra| more elements.
+  static Bucket *CopyOf(const Bucket *bucket, size_t extra) {
+    Bucket *copy = new Bucket();
+    if (bucket != nullptr) {
+      copy->reserve(bucket->size() + extra);
+      copy->assign(bucket->begin(), bucket->end());
+    } else {
+      copy->reserve(extra);
+    }
+    return copy;
+  }
 
-  bool ContainsNoLock(T elem, size_t my_bucket) {
-    std::vector<T> small_table = table_[my_bucket];
-    return std::find(small_table.begin(), small_table.end(), elem) !=
-           small_table.end();
+  // Publishes |bucket| in |slot|, as a null pointer if it is empty, and
+  // retires the bucket it replaces, which lookups may still be reading. The
+  // caller holds the mutex of the bucket.
+  void Publish(std::atomic<const Bucket *> &slot, Bucket *bucket) {
+    if (bucket != nullptr && bucket->empty()) {
+      delete bucket;
+      bucket = nullptr;
+    }
+    const Bucket *replaced = slot.load();
+    slot.store(bucket);
+    if (replaced != nullptr) {
+      epochs_.Retire(replaced);
+    }
   }
 
-  // Policy to resize, calculated using the atomic variable for element and
-  // bucket counts.
-  bool Policy() { return (elem_count_.load() / bucket_count_.load()) > 4; }
+  // Groups the indices of each slice of kBatchSliceSize elements of |elems|
+  // by mutex, and the indices of a mutex by bucket, see PartGroups, and,
+  // holding each mutex once per slice for all of its elements, calls
+  // |edit(bucket, copy, i, hash)| with the index and the hash of each element.
+  // |bucket| is the bucket of the element as the slice left it so far, and
+  // |copy()| returns the private copy of that bucket the slice edits, made on
+  // first use. Each copy is published once all the elements of its bucket
+  // are done, so that a bucket is copied once per slice rather than once per
+  // element. The reader lock, taken once per slice, keeps the tables and the
+  // mutex vector from being replaced meanwhile.
+  template <typename Edit>
+  void EditEachBucketOnce(const std::vector<T> &elems, Edit edit) {
+    std::vector<size_t> hashes(elems.size());
+    for (size_t i = 0; i < elems.size(); i++) {
+      hashes[i] = hash_(elems[i]);
+    }
+    std::vector<size_t> indices;
+    for (size_t begin = 0; begin < elems.size(); begin += kBatchSliceSize) {
+      indices.resize(std::min(kBatchSliceSize, elems.size() - begin));
+      std::iota(indices.begin(), indices.end(), begin);
+      std::shared_lock<std::shared_mutex> reader_lock(resizing_mutex_);
+      Tables &tables = *tables_.load();
+      size_t mutex_count = mutexes_.size();
+      size_t bucket_count = tables.current.BucketCount();
+      PartGroups groups(indices, mutex_count, [&](size_t i) {
+        return BucketIndex(hashes[i], mutex_count);
+      });
+      size_t group_count = groups.GroupCount();
+      size_t first = FirstGroupOfThread(group_count);
+      for (size_t step = 0; step < group_count; step++) {
+        PartGroups::Group group = groups.After(first, step);
+        size_t my_lock = group.Part();
+        std::scoped_lock<StripeMutex> lock(mutexes_[my_lock]);
+        // A shrinking migration publishes into a new bucket from several old
+        // ones, so every old bucket of the mutex we need is migrated before
+        // any new bucket is copied.
+        for (size_t i : group) {
+          Migrate(tables, hashes[i]);
+        }
+        // The mutex guards the buckets my_lock + k * mutex_count, grouped by
+        // k.
+        PartGroups buckets(group, bucket_count / mutex_count, [&](size_t i) {
+          return BucketIndex(hashes[i], bucket_count) / mutex_count;
+        });
+        for (size_t k = 0; k < buckets.GroupCount(); k++) {
+          PartGroups::Group elems_of_bucket = buckets.Of(k);
+          std::atomic<const Bucket *> &slot =
+              tables.current
+                  .buckets[my_lock + elems_of_bucket.Part() * mutex_count];
+          Bucket *copy = nullptr;
+          for (size_t i : elems_of_bucket) {
+            const Bucket *bucket = copy != nullptr ? copy : slot.load();
+            edit(bucket,
+                 [&]() -> Bucket & {
+                   if (copy == nullptr) {
+                     copy = CopyOf(slot.load(), elems_of_bucket.size());
+                   }
+                   return *copy;
+                 },
+                 i, hashes[i]);
+          }
+          if (copy != nullptr) {
+            Publish(slot, copy);
+          }
+        }
+      }
+    }
+  }
+
+  // The mutex count, read under the reader lock since resizes replace the
+  // mutexes.
+  size_t MutexCount() {
+    std::shared_lock<std::shared_mutex> reader_lock(resizing_mutex_);
+    return mutexes_.size();
+  }
+
+  // Runs |scan|, copying the elements of both tables that each mutex it
+  // visits guards while holding that mutex, and calling |visit| on them
+  // after. As in Acquire, the reader lock on the resizing mutex is only held
+  // until the mutex is, which then keeps resizes from replacing the tables.
+  template <typename Visit> void ScanStripes(StripeScan &scan, Visit visit) {
+    std::vector<T> elems;
+    while (!scan.Done()) {
+      elems.clear();
+      size_t mutex_count;
+      size_t my_lock;
+      std::unique_lock<StripeMutex> lock;
+      {
+        std::shared_lock<std::shared_mutex> reader_lock(resizing_mutex_);
+        mutex_count = mutexes_.size();
+        my_lock = BucketIndex(scan.Next(), mutex_count);
+        lock = std::unique_lock<StripeMutex>(mutexes_[my_lock]);
+      }
+      bool whole = scan.VisitsWholeLock(my_lock, mutex_count);
+      Tables *tables = tables_.load();
+      for (Table *table : {&tables->current, &tables->old}) {
+        for (size_t i = my_lock; i < table->BucketCount(); i += mutex_count) {
+          const Bucket *bucket = table->buckets[i].load();
+          if (bucket == nullptr) {
+            continue;
+          }
+          for (const T &elem : *bucket) {
+            if (whole || scan.Visits(hash_(elem))) {
+              elems.push_back(elem);
+            }
+          }
+        }
+      }
+      scan.MarkVisited(my_lock, mutex_count);
+      lock.unlock();
+      for (const T &elem : elems) {
+        visit(elem);
+      }
+    }
+  }
+
+  // Policy to resize, calculated using the sum of the element count shards and
+  // the atomic bucket count.
+  bool Policy() {
+    size_t bucket_count = bucket_count_.load();
+    return NewBucketCount(elem_count_.Sum(), bucket_count) != bucket_count;
+  }
+
+  // The same policy, but estimated from the load of the shard of the element
+  // with |hash| alone, so that Add and Remove only sum the whole element count
+  // once their shard looks due for a resize.
+  bool ShardPolicy(size_t hash) {
+    size_t shard = elem_count_.ShardOf(hash);
+    size_t bucket_count = bucket_count_.load();
+    return NewBucketCount(elem_count_.Get(shard) * elem_count_.ShardCount(),
+                          bucket_count) != bucket_count;
+  }
+
+  size_t NewBucketCount(size_t elem_count, size_t bucket_count) {
+    return resize_policy_.TargetBucketCount(elem_count, bucket_count,
+                                            min_bucket_count_.load());
+  }
 
   /*
    * When resizing, we lock the resizing mutex to ensure that no other threads
    * can start resizing after that we also use quiesce to ensure that every
    * thread has released all the mutexes they are using. Then, we resize the new
-   * vector of mutexes and the table.
+   * vector of mutexes and publish the new table. Lookups may still be reading
+   * the old one, so its elements are copied rather than moved.
    */
   void Resize() {
     size_t old_capacity = bucket_count_.load();
+    StatsRecorder::TimePoint begin_time = stats_.Now();
     std::lock_guard<std::shared_mutex> writer_lock(resizing_mutex_);
-    size_t new_capacity = 2 * old_capacity;
     // This is to ensure we are not resizing more than once at a time.
     if (bucket_count_.load() != old_capacity) {
       return;
     }
+    StatsRecorder::TimePoint quiesce_begin_time = stats_.Now();
     Quiesce();
+    stats_.Quiesced(quiesce_begin_time);
+    // Once quiesced the element count is exact, so we check the policy again.
+    size_t new_capacity = NewBucketCount(elem_count_.Sum(), old_capacity);
+    if (new_capacity == old_capacity) {
+      return;
+    }
+    ResizeTo(new_capacity, begin_time);
+  }
+
+  // Resizes the table to |new_capacity| buckets. The caller holds the
+  // resizing mutex and has quiesced all the other threads.
+  void ResizeTo(size_t new_capacity, StatsRecorder::TimePoint begin_time) {
+    size_t old_capacity = bucket_count_.load();
+    if (resize_mode_ == ResizeMode::kIncremental) {
+      StartMigration(new_capacity);
+      stats_.Resized(begin_time);
+      return;
+    }
+    ReplaceMutexes(MutexCountFor(new_capacity));
+    Tables *old_tables = tables_.load();
+    // A stop-the-world resize never leaves an old table behind.
+    assert(old_tables->old.BucketCount() == 0);
+    Tables *tables = new Tables(new_capacity, 0);
+    // The elements are copied into buckets reserved for the average load.
+    std::vector<Bucket> table(new_capacity);
+    size_t elem_count = elem_count_.Sum();
+    size_t group_count = std::min(old_capacity, new_capacity);
+    ParallelFor(group_count,
+                ThreadCountFor(elem_count, kMinElemsPerThread),
+                [&](size_t begin, size_t end) {
+                  RehashGroups(begin, end, old_tables->current, table,
+                               elem_count / new_capacity + 1);
+                  Publish(begin, end, group_count, table, tables->current);
+                });
     bucket_count_.store(new_capacity);
-    mutexes_ = std::vector<std::mutex>(bucket_count_.load());
-    std::vector<std::vector<T>> table;
-    table.resize(new_capacity);
-    for (size_t i = 0; i < new_capacity; i++) {
-      table[i] = std::vector<T>();
+    tables_.store(tables);
+    // The old buckets are only retired once lookups can no longer reach them.
+    RetireTables(old_tables);
+    stats_.Resized(begin_time);
+  }
+
+  // Copies the elements of the buckets of |old_table| whose index modulo the
+  // smaller of the two bucket counts is in [begin, end) into |table|, whose
+  // buckets of that range are reserved for |bucket_size| elements first. The
+  // larger count is a multiple of the smaller one, so these elements only
+  // hash to buckets of the same range, and stop-the-world resizes of large
+  // tables split the range over a few threads. The caller has quiesced the
+  // other threads.
+  void RehashGroups(size_t begin, size_t end, const Table &old_table,
+                    std::vector<Bucket> &table, size_t bucket_size) {
+    size_t group_count = std::min(old_table.BucketCount(), table.size());
+    for (size_t first = 0; first < table.size(); first += group_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        table[i].reserve(bucket_size);
+      }
+    }
+    for (size_t first = 0; first < old_table.BucketCount();
+         first += group_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        const Bucket *bucket = old_table.buckets[i].load();
+        if (bucket == nullptr) {
+          continue;
+        }
+        for (const T &elem : *bucket) {
+          table[BucketIndex(hash_(elem), table.size())].push_back(elem);
+        }
+      }
     }
-    for (std::vector<T> bucket : table_) {
-      for (T elem : bucket) {
-        table[std::hash<T>()(elem) % new_capacity].push_back(elem);
+  }
+
+  // Moves the non-empty buckets of |table| whose index modulo |group_count|
+  // is in [begin, end) into |new_table|, which is not published yet.
+  static void Publish(size_t begin, size_t end, size_t group_count,
+                      std::vector<Bucket> &table, Table &new_table) {
+    for (size_t first = 0; first < table.size(); first += group_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        if (!table[i].empty()) {
+          new_table.buckets[i].store(new Bucket(std::move(table[i])));
+        }
       }
     }
-    table_ = table;
   }
+
+  // Retires |tables| together with the buckets they publish. The caller has
+  // already published the tables that replace them.
+  void RetireTables(const Tables *tables) {
+    for (const Table *table : {&tables->current, &tables->old}) {
+      for (const std::atomic<const Bucket *> &slot : table->buckets) {
+        const Bucket *bucket = slot.load();
+        if (bucket != nullptr) {
+          epochs_.Retire(bucket);
+        }
+      }
+    }
+    epochs_.Retire(tables);
+  }
+
+  // The mutex count for |bucket_count| buckets: one per bucket, as long as
+  // that stays within the lock cap of the resize policy.
+  size_t MutexCountFor(size_t bucket_count) const {
+    return resize_policy_.TargetLockCount(
+        bucket_count, std::min(mutexes_.size(), bucket_count));
+  }
+
+  // Replaces the mutexes with |count| new ones. The caller has quiesced all
+  // the other threads.
+  void ReplaceMutexes(size_t count) {
+    for (const StripeMutex &mutex : mutexes_) {
+      stats_.Retire(mutex);
+    }
+    mutexes_ = std::vector<StripeMutex>(count);
+  }
+
+  // Moves the old buckets that were not migrated yet into the new table, and
+  // publishes new tables in which the current table is the old one. The
+  // buckets move over to the new tables, so only the old tables themselves are
+  // retired. The caller holds the resizing mutex and has quiesced all the
+  // other threads.
+  void StartMigration(size_t new_capacity) {
+    Tables *old_tables = tables_.load();
+    for (size_t i = 0; i < old_tables->old.BucketCount(); i++) {
+      MigrateBucket(*old_tables, i);
+    }
+    size_t old_bucket_count = old_tables->current.BucketCount();
+    Tables *tables = new Tables(new_capacity, old_bucket_count);
+    for (size_t i = 0; i < old_bucket_count; i++) {
+      tables->old.buckets[i].store(old_tables->current.buckets[i].load());
+    }
+    ReplaceMutexes(MutexCountFor(std::min(old_bucket_count, new_capacity)));
+    bucket_count_.store(new_capacity);
+    tables_.store(tables);
+    epochs_.Retire(old_tables);
+  }
+
+  // The caller holds the mutex of the element with |hash|, which guards its
+  // old bucket. We migrate that bucket, so that the operation only has to look
+  // at the new table.
+  void Migrate(Tables &tables, size_t hash) {
+    size_t old_bucket_count = tables.old.BucketCount();
+    if (old_bucket_count != 0) {
+      MigrateBucket(tables, BucketIndex(hash, old_bucket_count));
+    }
+  }
+
+  // The elements of an old bucket go to a single new bucket when the table
+  // shrinks, and to every new bucket congruent to it modulo the old bucket
+  // count when it grows. Each of those new buckets is copied once, and they
+  // are all published before the old bucket is emptied.
+  void MigrateBucket(Tables &tables, size_t old_bucket) {
+    std::atomic<const Bucket *> &old_slot = tables.old.buckets[old_bucket];
+    const Bucket *bucket = old_slot.load();
+    if (bucket == nullptr) {
+      return;
+    }
+    size_t old_capacity = tables.old.BucketCount();
+    size_t new_capacity = tables.current.BucketCount();
+    for (size_t new_bucket = old_bucket % new_capacity;
+         new_bucket < new_capacity; new_bucket += old_capacity) {
+      std::atomic<const Bucket *> &slot = tables.current.buckets[new_bucket];
+      Bucket *copy = CopyOf(slot.load(), bucket->size());
+      for (const T &elem : *bucket) {
+        if (BucketIndex(hash_(elem), new_capacity) == new_bucket) {
+          copy->push_back(elem);
+        }
+      }
+      Publish(slot, copy);
+    }
+    Publish(old_slot, nullptr);
+  }
+
   // The quiesce function acquires all locks, so that it ensures that mutexes
   // are free.
   void Quiesce() {
-    for (std::mutex &mutex : mutexes_) {
-      std::scoped_lock<std::mutex> lock(mutex);
+    for (StripeMutex &mutex : mutexes_) {
+      std::scoped_lock<StripeMutex> lock(mutex);
     }
   }
 
   /*
    * We use a custom acquire function to lock the corresponding mutex for each
-   * bucket given the element to search for. It also acquires a reader lock to
-   * let any non-resizing operation occur concurrently.
+   * bucket given the hash of the element to search for, and return its index.
+   * It also acquires a reader lock to let any non-resizing operation occur
+   * concurrently.
    */
-  void Acquire(T elem) {
+  size_t Acquire(size_t hash) {
     std::shared_lock<std::shared_mutex> reader_lock(resizing_mutex_);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-    mutexes_[my_bucket].lock();
+    size_t my_lock = BucketIndex(hash, mutexes_.size());
+    mutexes_[my_lock].lock();
+    return my_lock;
   }
 
-  // Custom release function for the mutex of the bucket corresponding to the
-  // passed elem argument.
-  void Release(T elem) {
-    mutexes_[std::hash<T>()(elem) % bucket_count_.load()].unlock();
-  }
+  // Custom release function for the mutex |my_lock| returned by Acquire. The
+  // mutex vector cannot be resized while the mutex is held.
+  void Release(size_t my_lock) { mutexes_[my_lock].unlock(); }
 
   // Auxiliary class that creates a scoped lock, using the custom acquire
-  // function.
+  // function. It only keeps the index of the mutex, not the element.
   class CustomScopedLock {
   public:
-    CustomScopedLock(HashSetRefinable<T> *hashSetRefinable, T elem)
-        : hashSetRefinable_(hashSetRefinable), elem_(elem) {
-      hashSetRefinable_->Acquire(elem_);
-    }
-    ~CustomScopedLock() { hashSetRefinable_->Release(elem_); }
+    CustomScopedLock(HashSetRefinable *hashSetRefinable, size_t hash)
+        : hashSetRefinable_(hashSetRefinable),
+          my_lock_(hashSetRefinable_->Acquire(hash)) {}
+    ~CustomScopedLock() { hashSetRefinable_->Release(my_lock_); }
+
+    CustomScopedLock(const CustomScopedLock &) = delete;
+    CustomScopedLock &operator=(const CustomScopedLock &) = delete;
 
   private:
-    HashSetRefinable<T> *hashSetRefinable_;
-    T elem_;
+    HashSetRefinable *hashSetRefinable_;
+    size_t my_lock_;
   };
 };
 
@@ -3,76 +3,148 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "src/hash_functions.h"
 #include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/resize_policy.h"
 
-template <typename T> class HashSetSequential : public HashSetBase<T> {
+// The buckets allocate their storage with |Allocator|, such as the
+// SlabAllocator of slab_allocator.h.
+template <typename T, typename Hash = std::hash<T>,
+          typename Allocator = std::allocator<T>>
+class HashSetSequential
+    : public HashSetBase<HashSetSequential<T, Hash, Allocator>, T> {
 public:
-  explicit HashSetSequential(size_t capacity)
-      : bucket_count_(capacity), elem_count_(0) {
-    table_.resize(bucket_count_);
-    for (size_t i = 0; i < bucket_count_; i++) {
-      table_[i] = std::vector<T>();
+  explicit HashSetSequential(size_t capacity,
+                             ResizePolicy resize_policy = ResizePolicy(),
+                             Hash hash = Hash())
+      : hash_(std::move(hash)), bucket_count_(capacity),
+        min_bucket_count_(capacity), elem_count_(0),
+        resize_policy_(resize_policy) {
+    table_ = MakeTable(bucket_count_);
+  }
+
+  // Builds the hash set of |elems| with a table sized for all of them.
+  HashSetSequential(const std::vector<T> &elems, size_t capacity,
+                    ResizePolicy resize_policy = ResizePolicy(),
+                    Hash hash = Hash())
+      : HashSetSequential(capacity, resize_policy, std::move(hash)) {
+    Reserve(elems.size());
+    for (const T &elem : elems) {
+      Add(elem);
     }
   }
 
-  bool Add(T elem) final {
+  bool Add(T elem) {
     if (ContainsNoLock(elem))
       return false;
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
     table_[my_bucket].push_back(elem);
     elem_count_++;
     if (Policy()) {
+      stats_.PolicyTriggered();
       Resize();
     }
     return true;
   }
 
-  bool Remove(T elem) final {
+  bool Remove(T elem) {
     if (!ContainsNoLock(elem))
       return false;
     assert(elem_count_ != 0);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
     table_[my_bucket].erase(
         std::find(table_[my_bucket].begin(), table_[my_bucket].end(), elem));
     elem_count_--;
+    if (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
     return true;
   }
 
-  [[nodiscard]] bool Contains(T elem) final { return ContainsNoLock(elem); }
+  [[nodiscard]] bool Contains(T elem) { return ContainsNoLock(elem); }
+
+  [[nodiscard]] size_t Size() const { return elem_count_; }
+
+  // Grows the table, in a single rehash, to the size it would grow to while
+  // |elem_count| elements were added, and keeps it from shrinking below that
+  // size.
+  void Reserve(size_t elem_count) {
+    min_bucket_count_ =
+        resize_policy_.BucketCountFor(elem_count, min_bucket_count_);
+    if (min_bucket_count_ > bucket_count_) {
+      Rehash(min_bucket_count_);
+    }
+  }
 
-  [[nodiscard]] size_t Size() const final { return elem_count_; }
+#ifdef HASH_SET_STATS
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    stats_.Report(stats);
+    StatsRecorder::ReportBuckets(table_, stats);
+    stats.average_bucket_length = static_cast<double>(elem_count_) /
+                                  static_cast<double>(bucket_count_);
+    return stats;
+  }
+#endif
 
 private:
-  std::vector<std::vector<T>> table_;
+  using Bucket = std::vector<T, Allocator>;
+
+  Hash hash_;
+  // Every bucket allocates from a copy of |allocator_|.
+  Allocator allocator_;
+  std::vector<Bucket> table_;
   size_t bucket_count_;
+  // The table never shrinks below its initial or reserved bucket count.
+  size_t min_bucket_count_;
   size_t elem_count_;
+  ResizePolicy resize_policy_;
+  StatsRecorder stats_;
+
+  bool Policy() { return NewBucketCount() != bucket_count_; }
 
-  bool Policy() { return (elem_count_ / bucket_count_) > 4; }
+  size_t NewBucketCount() {
+    return resize_policy_.TargetBucketCount(elem_count_, bucket_count_,
+                                            min_bucket_count_);
+  }
+
+  void Resize() { Rehash(NewBucketCount()); }
 
-  void Resize() {
-    size_t old_capacity = bucket_count_;
-    size_t new_capacity = 2 * old_capacity;
+  void Rehash(size_t new_capacity) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
     bucket_count_ = new_capacity;
-    std::vector<std::vector<T>> table;
-    table.resize(new_capacity);
-    for (size_t i = 0; i < new_capacity; i++) {
-      table[i] = std::vector<T>();
+    // Each new bucket is reserved for the average load, and the elements are
+    // moved over, so the old table is the only other copy.
+    std::vector<Bucket> table = MakeTable(new_capacity);
+    size_t bucket_size = elem_count_ / new_capacity + 1;
+    for (Bucket &bucket : table) {
+      bucket.reserve(bucket_size);
     }
-    for (std::vector<T> bucket : table_) {
-      for (T elem : bucket) {
-        table[std::hash<T>()(elem) % new_capacity].push_back(elem);
+    for (Bucket &bucket : table_) {
+      for (T &elem : bucket) {
+        table[BucketIndex(hash_(elem), new_capacity)].push_back(
+            std::move(elem));
       }
     }
-    table_ = table;
+    table_.swap(table);
+    stats_.Resized(begin_time);
+  }
+
+  std::vector<Bucket> MakeTable(size_t bucket_count) {
+    return std::vector<Bucket>(bucket_count, Bucket(allocator_));
   }
 
   bool ContainsNoLock(T elem) {
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_;
-    std::vector<T> small_table = table_[my_bucket];
-    return std::find(small_table.begin(), small_table.end(), elem) !=
-           small_table.end();
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
+    const Bucket &bucket = table_[my_bucket];
+    return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
   }
 };
 
@@ -0,0 +1,188 @@
+#ifndef HASH_SET_STATS_H
+#define HASH_SET_STATS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "src/reader_lock.h"
+
+/*
+ * Instrumentation of the hash sets, compiled in with -DHASH_SET_STATS. The
+ * hash sets then count the acquisitions of each of their locks, and how many
+ * of them found the lock taken, as well as how often their policy asked for a
+ * resize and how long resizing and quiescing took, and HashSetBase::Stats
+ * reports the counters together with the bucket lengths.
+ *
+ * Without HASH_SET_STATS, StatsMutex<Mutex> is Mutex itself and the methods
+ * of StatsRecorder are empty, so the instrumented code compiles to the same
+ * code as before.
+ */
+
+#ifdef HASH_SET_STATS
+
+struct HashSetStats {
+  // The acquisitions of each current lock, including those made while
+  // resizing, and how many of them had to wait for another thread.
+  std::vector<size_t> lock_acquisitions;
+  std::vector<size_t> contended_acquisitions;
+  // The same counts summed over every lock the hash set ever had, as the
+  // refinable set replaces its locks when resizing.
+  size_t total_lock_acquisitions = 0;
+  size_t total_contended_acquisitions = 0;
+  size_t policy_triggers = 0;
+  size_t resize_count = 0;
+  std::chrono::nanoseconds resize_time{0};
+  size_t quiesce_count = 0;
+  std::chrono::nanoseconds quiesce_time{0};
+  size_t max_bucket_length = 0;
+  double average_bucket_length = 0.0;
+};
+
+// A |Mutex| that counts its acquisitions. A contended acquisition is one
+// whose try_lock fails before it blocks. The counters sit next to the mutex,
+// so that a thread only updates the counters of the locks it takes.
+template <typename Mutex> class CountedMutex : public Mutex {
+public:
+  void lock() {
+    if (!Mutex::try_lock()) {
+      contended_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+      Mutex::lock();
+    }
+    lock_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  template <typename M = Mutex,
+            typename = std::enable_if_t<IsSharedMutex<M>::value>>
+  void lock_shared() {
+    if (!Mutex::try_lock_shared()) {
+      contended_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+      Mutex::lock_shared();
+    }
+    lock_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t LockAcquisitions() const {
+    return lock_acquisitions_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t ContendedAcquisitions() const {
+    return contended_acquisitions_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<size_t> lock_acquisitions_{0};
+  std::atomic<size_t> contended_acquisitions_{0};
+};
+
+template <typename Mutex> using StatsMutex = CountedMutex<Mutex>;
+
+#else
+
+template <typename Mutex> using StatsMutex = Mutex;
+
+#endif // HASH_SET_STATS
+
+// The counters of a hash set that are not tied to a lock. They are updated
+// outside of the locks, so they are relaxed atomics.
+class StatsRecorder {
+public:
+#ifdef HASH_SET_STATS
+  using TimePoint = std::chrono::steady_clock::time_point;
+#else
+  struct TimePoint {};
+#endif
+
+  // The start of a resize or a quiesce, to pass to Resized or Quiesced.
+  [[nodiscard]] TimePoint Now() const {
+#ifdef HASH_SET_STATS
+    return std::chrono::steady_clock::now();
+#else
+    return TimePoint();
+#endif
+  }
+
+  void PolicyTriggered() {
+#ifdef HASH_SET_STATS
+    policy_triggers_.fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+
+  void Resized([[maybe_unused]] TimePoint begin) {
+#ifdef HASH_SET_STATS
+    resize_count_.fetch_add(1, std::memory_order_relaxed);
+    resize_nanos_.fetch_add(NanosSince(begin), std::memory_order_relaxed);
+#endif
+  }
+
+  void Quiesced([[maybe_unused]] TimePoint begin) {
+#ifdef HASH_SET_STATS
+    quiesce_count_.fetch_add(1, std::memory_order_relaxed);
+    quiesce_nanos_.fetch_add(NanosSince(begin), std::memory_order_relaxed);
+#endif
+  }
+
+  // Counts the acquisitions of |mutex| in the totals before it is destroyed.
+  template <typename Mutex> void Retire([[maybe_unused]] const Mutex &mutex) {
+#ifdef HASH_SET_STATS
+    retired_acquisitions_.fetch_add(mutex.LockAcquisitions(),
+                                    std::memory_order_relaxed);
+    retired_contended_acquisitions_.fetch_add(mutex.ContendedAcquisitions(),
+                                              std::memory_order_relaxed);
+#endif
+  }
+
+#ifdef HASH_SET_STATS
+  // Fills in the counters of |stats| that are kept here.
+  void Report(HashSetStats &stats) const {
+    stats.total_lock_acquisitions += retired_acquisitions_.load();
+    stats.total_contended_acquisitions +=
+        retired_contended_acquisitions_.load();
+    stats.policy_triggers = policy_triggers_.load();
+    stats.resize_count = resize_count_.load();
+    stats.resize_time = std::chrono::nanoseconds(resize_nanos_.load());
+    stats.quiesce_count = quiesce_count_.load();
+    stats.quiesce_time = std::chrono::nanoseconds(quiesce_nanos_.load());
+  }
+
+  // Appends the counters of |mutex| to |stats|.
+  template <typename Mutex>
+  static void ReportLock(const Mutex &mutex, HashSetStats &stats) {
+    stats.lock_acquisitions.push_back(mutex.LockAcquisitions());
+    stats.contended_acquisitions.push_back(mutex.ContendedAcquisitions());
+    stats.total_lock_acquisitions += mutex.LockAcquisitions();
+    stats.total_contended_acquisitions += mutex.ContendedAcquisitions();
+  }
+
+  // Raises the maximum bucket length of |stats| to the longest bucket of
+  // |table|.
+  template <typename Table>
+  static void ReportBuckets(const Table &table, HashSetStats &stats) {
+    for (const auto &bucket : table) {
+      stats.max_bucket_length =
+          std::max(stats.max_bucket_length, bucket.size());
+    }
+  }
+
+private:
+  std::atomic<size_t> policy_triggers_{0};
+  std::atomic<size_t> resize_count_{0};
+  std::atomic<size_t> resize_nanos_{0};
+  std::atomic<size_t> quiesce_count_{0};
+  std::atomic<size_t> quiesce_nanos_{0};
+  std::atomic<size_t> retired_acquisitions_{0};
+  std::atomic<size_t> retired_contended_acquisitions_{0};
+
+  static size_t NanosSince(TimePoint begin) {
+    return static_cast<size_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin)
+            .count());
+  }
+#endif // HASH_SET_STATS
+};
+
+#endif // HASH_SET_STATS_H
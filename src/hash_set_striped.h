@@ -5,121 +5,720 @@
 #include <atomic>
 #include <cassert>
 #include <deque>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <numeric>
+#include <optional>
+#include <utility>
 #include <vector>
 
+#include "src/cache_aligned.h"
+#include "src/hash_functions.h"
 #include "src/hash_set_base.h"
+#include "src/hash_set_stats.h"
+#include "src/parallel_for.h"
+#include "src/part_groups.h"
+#include "src/reader_lock.h"
+#include "src/resize_mode.h"
+#include "src/resize_policy.h"
 #include "src/scoped_vector_lock.h"
+#include "src/sharded_counter.h"
+#include "src/stripe_scan.h"
 /*
  * The striped solution is mainly inspired on the Art of Multiprocessor
  * Programming implementation. We mostly acquire a scoped lock on a specific
  * mutex based on the hash of the element. When resizing, we followed the same
  * principle as the book suggested, where we lock the entire mutex array so that
- * the hashset is not being accessed while resizing is happening.
+ * the hashset is not being accessed while resizing is happening. In the
+ * incremental resize mode, the locked section of a resize only swaps in an
+ * empty table, and the elements are migrated from the old table by the
+ * operations that lock their stripe afterwards.
+ *
+ * When the Mutex can be locked for reading, such as std::shared_mutex wrapped
+ * in CacheAligned, lookups only lock their stripe for reading, so that they
+ * exclude Add and Remove but not each other.
+ *
+ * The lock count grows with the table, as its ResizePolicy says, up to a cap
+ * tied to the hardware concurrency, so that a set constructed with a small
+ * capacity does not keep a handful of locks for millions of buckets. Every
+ * lock is allocated up front and the lock count only changes while all of
+ * them are held, so an operation that waited for its lock during such a
+ * resize notices the new count once it gets the lock, and tries again.
+ *
+ * Each stripe has its own |Allocator| for the storage of its buckets. A
+ * stateful allocator such as the SlabAllocator of slab_allocator.h then needs
+ * no lock of its own, since only the holder of the stripe lock uses it. The
+ * tables of buckets come from one more |Allocator|, rebound to the buckets,
+ * which is only used while all the locks are held, so that an allocator such
+ * as the NodeAllocator of node_memory.h places every table a resize makes too.
  */
-template <typename T> class HashSetStriped : public HashSetBase<T> {
+template <typename T, typename Hash = std::hash<T>,
+          typename Mutex = CacheAligned<std::mutex>,
+          typename Allocator = std::allocator<T>>
+class HashSetStriped
+    : public HashSetBase<HashSetStriped<T, Hash, Mutex, Allocator>, T> {
 public:
-  explicit HashSetStriped(size_t capacity)
-      : bucket_count_(capacity), initial_bucket_count_(capacity),
-        elem_count_(0) {
-    table_.resize(bucket_count_.load());
-    mutexes_ = std::vector<std::mutex>(initial_bucket_count_);
-    for (size_t i = 0; i < bucket_count_.load(); i++) {
-      table_[i] = std::vector<T>();
-    }
+  explicit HashSetStriped(size_t capacity,
+                          ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                          ResizePolicy resize_policy = ResizePolicy(),
+                          Hash hash = Hash())
+      : hash_(std::move(hash)), bucket_count_(capacity),
+        lock_count_(capacity), min_bucket_count_(capacity),
+        elem_count_(capacity), resize_mode_(resize_mode),
+        resize_policy_(resize_policy), old_bucket_count_(0) {
+    size_t max_lock_count = resize_policy_.TargetLockCount(
+        std::numeric_limits<size_t>::max(), capacity);
+    allocators_ = std::vector<Allocator>(max_lock_count);
+    table_ = MakeTable(bucket_count_.load());
+    mutexes_ = std::vector<StripeMutex>(max_lock_count);
+    cursors_ = std::vector<size_t>(max_lock_count, 0);
+  }
+
+  // Builds the hash set of |elems| with a table sized for all of them. Large
+  // sets are filled by a few threads, each adding the elements of some of the
+  // locks, without taking any lock.
+  HashSetStriped(const std::vector<T> &elems, size_t capacity,
+                 ResizeMode resize_mode = ResizeMode::kStopTheWorld,
+                 ResizePolicy resize_policy = ResizePolicy(),
+                 Hash hash = Hash())
+      : HashSetStriped(capacity, resize_mode, resize_policy, std::move(hash)) {
+    Reserve(elems.size());
+    size_t lock_count = lock_count_.load();
+    size_t thread_count = ThreadCountFor(elems.size(), kMinElemsPerThread);
+    std::vector<size_t> hashes(elems.size());
+    ParallelFor(elems.size(), thread_count, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        hashes[i] = hash_(elems[i]);
+      }
+    });
+    auto lock_of = [&](size_t i) { return BucketIndex(hashes[i], lock_count); };
+    ParallelForEachPart(
+        elems.size(), lock_count, thread_count, lock_of, [&](size_t i) {
+          return AddNoLock(elems[i], hashes[i], lock_of(i));
+        });
   }
 
   // We find the mutex corresponding to our bucket, and then we lock it so no
   // one else accesses the same bucket. We release the lock once we check our
   // policy to ensure when resizing we don't run into the problem of acquiring
-  // the same lock.
-  bool Add(T elem) final {
-    size_t my_lock = std::hash<T>()(elem) % initial_bucket_count_;
-    {
-      std::scoped_lock<std::mutex> lock(mutexes_[my_lock]);
-      size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-      if (ContainsNoLock(elem, my_bucket)) {
-        return false;
-      }
-      table_[my_bucket].push_back(elem);
-      elem_count_.fetch_add(1);
+  // the same lock. The element is hashed once, and an rvalue is moved into
+  // its bucket.
+  bool Add(const T &elem) { return AddHashed(elem, hash_(elem)); }
+
+  bool Add(T &&elem) {
+    size_t hash = hash_(elem);
+    return AddHashed(std::move(elem), hash);
+  }
+
+  // Adds the element constructed from |args|. As in the standard sets, the
+  // element is constructed before it is looked up.
+  template <typename... Args> bool Emplace(Args &&...args) {
+    return Add(T(std::forward<Args>(args)...));
+  }
+
+  // When removing an element we apply the same principle we did for the add
+  // operation so we lock the correct mutex remove the element from the bucket,
+  // and then check whether the table should shrink.
+  bool Remove(const T &elem) { return RemoveHashed(elem, hash_(elem)); }
+
+  // With a transparent Hash, see IsTransparent, elements can be removed and
+  // looked up by any key that Hash hashes and that compares equal to them,
+  // without constructing an element.
+  template <typename K,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, K>>
+  bool Remove(const K &key) {
+    return RemoveHashed(key, hash_(key));
+  }
+
+  // For the contains operation we again lock the corresponding mutex, this
+  // time for reading, and search the bucket.
+  [[nodiscard]] bool Contains(const T &elem) {
+    return ContainsHashed(elem, hash_(elem));
+  }
+
+  template <typename K,
+            typename = std::enable_if_t<IsTransparent<Hash>::value, K>>
+  [[nodiscard]] bool Contains(const K &key) {
+    return ContainsHashed(key, hash_(key));
+  }
+
+  // The batch operations take each lock once per slice of the batch for all
+  // the elements it guards, see LockEachStripeOnce, and only check the policy
+  // once per batch. AddAll grows the table for the whole batch before it takes
+  // any lock, so that the buckets stay within the load factor while the batch
+  // fills them.
+  size_t AddAll(const std::vector<T> &elems) {
+    GrowFor(Size() + elems.size());
+    size_t added = 0;
+    LockEachStripeOnce<std::scoped_lock<StripeMutex>>(
+        elems, [&](size_t my_lock, size_t i, size_t hash) {
+          if (AddNoLock(elems[i], hash, my_lock)) {
+            added++;
+          }
+        });
+    while (Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
     }
-    if (Policy()) {
+    return added;
+  }
+
+  size_t RemoveAll(const std::vector<T> &elems) {
+    size_t removed = 0;
+    LockEachStripeOnce<std::scoped_lock<StripeMutex>>(
+        elems, [&](size_t my_lock, size_t i, size_t hash) {
+          if (RemoveNoLock(elems[i], hash, my_lock).has_value()) {
+            removed++;
+          }
+        });
+    while (Policy()) {
+      stats_.PolicyTriggered();
       Resize();
     }
-    return true;
+    return removed;
   }
 
-  // When removing an element we apply the same principle we did for the add
-  // operation so we lock the correct mutex remove the element from the bucket.
-  bool Remove(T elem) final {
-    size_t my_lock = std::hash<T>()(elem) % initial_bucket_count_;
-    std::scoped_lock<std::mutex> lock(mutexes_[my_lock]);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-    if (!ContainsNoLock(elem, my_bucket))
-      return false;
-    assert(elem_count_ != 0);
-    table_[my_bucket].erase(
-        std::find(table_[my_bucket].begin(), table_[my_bucket].end(), elem));
-    elem_count_.fetch_sub(1);
-    return true;
+  [[nodiscard]] std::vector<bool>
+  ContainsMany(const std::vector<T> &elems) {
+    std::vector<bool> results(elems.size());
+    LockEachStripeOnce<ScopedReaderLock<StripeMutex>>(
+        elems, [&](size_t my_lock, size_t i, size_t hash) {
+          results[i] = ContainsReader(elems[i], hash, my_lock);
+        });
+    return results;
   }
 
-  // For the contains operation we again lock the corresponding mutex and search
-  // the bucket.
-  [[nodiscard]] bool Contains(T elem) final {
-    size_t my_lock = std::hash<T>()(elem) % initial_bucket_count_;
-    std::scoped_lock<std::mutex> lock(mutexes_[my_lock]);
-    size_t my_bucket = std::hash<T>()(elem) % bucket_count_.load();
-    return ContainsNoLock(elem, my_bucket);
+  [[nodiscard]] size_t Size() const { return elem_count_.Sum(); }
+
+  // Grows the table, in a single resize, to the size it would grow to while
+  // |elem_count| elements were added, and keeps it from shrinking below that
+  // size.
+  void Reserve(size_t elem_count) {
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    ScopedVectorLock<StripeMutex> scopedLockVector(mutexes_);
+    size_t min_bucket_count =
+        resize_policy_.BucketCountFor(elem_count, min_bucket_count_.load());
+    min_bucket_count_.store(min_bucket_count);
+    if (min_bucket_count > bucket_count_.load()) {
+      ResizeTo(min_bucket_count, begin_time);
+    }
+  }
+
+  // Calls |fn| on every element, stripe by stripe, holding a single lock at a
+  // time, for reading. The elements of each stripe are copied under its lock
+  // and |fn| is called once the lock is released, so that |fn| may use the
+  // hash set. The iteration is weakly consistent, see StripeScan: it visits
+  // the elements present throughout once, and those added or removed
+  // meanwhile at most once.
+  template <typename Fn> void ForEach(Fn fn) {
+    size_t lock_count = lock_count_.load();
+    StripeScan scan(mutexes_.size(), lock_count, 0, lock_count);
+    ScanStripes(scan, fn);
   }
 
-  [[nodiscard]] size_t Size() const final { return elem_count_.load(); }
+  // The same scan split over |thread_count| threads, each given a range of
+  // the stripes, which calls |fn(thread, elem)| on the elements of its
+  // stripes, with |thread| its index in [0, thread_count). Calls from the same
+  // thread are never concurrent, so that |fn| can aggregate into per-thread
+  // slots without synchronization.
+  template <typename Fn> void ParallelForEach(size_t thread_count, Fn fn) {
+    size_t lock_count = lock_count_.load();
+    thread_count = std::clamp<size_t>(thread_count, 1, lock_count);
+    ParallelFor(thread_count, thread_count, [&](size_t begin, size_t end) {
+      for (size_t thread = begin; thread < end; thread++) {
+        StripeScan scan(mutexes_.size(), lock_count,
+                        thread * lock_count / thread_count,
+                        (thread + 1) * lock_count / thread_count);
+        ScanStripes(scan, [&](const T &elem) { fn(thread, elem); });
+      }
+    });
+  }
+
+  // Copies every element, in no particular order, while holding all the
+  // locks, so that the copy is the hash set as it was at a single point in
+  // time. See WriteSnapshot in snapshot_image.h.
+  [[nodiscard]] std::vector<T> Snapshot() {
+    ScopedVectorLock<StripeMutex> scopedLockVector(mutexes_);
+    std::vector<T> elems;
+    elems.reserve(elem_count_.Sum());
+    for (const Table *table : {&table_, &old_table_}) {
+      for (const Bucket &bucket : *table) {
+        elems.insert(elems.end(), bucket.begin(), bucket.end());
+      }
+    }
+    return elems;
+  }
+
+#ifdef HASH_SET_STATS
+  // The lock counters are read before we lock the whole hash set to scan the
+  // buckets, so that they do not include our own acquisitions.
+  [[nodiscard]] HashSetStats Stats() {
+    HashSetStats stats;
+    for (size_t i = 0; i < lock_count_.load(); i++) {
+      StatsRecorder::ReportLock(mutexes_[i], stats);
+    }
+    stats_.Report(stats);
+    ScopedVectorLock<StripeMutex> scopedLockVector(mutexes_);
+    StatsRecorder::ReportBuckets(table_, stats);
+    StatsRecorder::ReportBuckets(old_table_, stats);
+    stats.average_bucket_length = static_cast<double>(elem_count_.Sum()) /
+                                  static_cast<double>(bucket_count_.load());
+    return stats;
+  }
+#endif
 
 private:
-  std::vector<std::vector<T>> table_;
+  // The hash map of hash_map_striped.h stores its entries in a hash set, and
+  // finds and updates them under the stripe locks of the set.
+  template <typename, typename, typename, typename>
+  friend class HashMapStriped;
+
+  // The mutexes count their acquisitions when the stats are compiled in.
+  using StripeMutex = StatsMutex<Mutex>;
+  using Bucket = std::vector<T, Allocator>;
+  using TableAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+  using Table = std::vector<Bucket, TableAllocator>;
+
+  Hash hash_;
+  // The allocator of the tables themselves, used while all the locks are held.
+  TableAllocator table_allocator_;
+  Table table_;
   // We ensure that the bucket count is right by making it an atomic variable.
   std::atomic<size_t> bucket_count_;
-  // We keep track of the initial bucket count because the vector of mutexes
-  // does not resize.
-  size_t initial_bucket_count_;
-  // The element count must be atomic, so that we can have multiple operations
-  // on separate buckets.
-  std::atomic<size_t> elem_count_;
-  // A vector of mutexes for each initial bucket at first after resizing more
-  // buckets will share the same lock.
-  std::vector<std::mutex> mutexes_;
+  // The number of locks in use. It only changes while all the locks are
+  // held.
+  std::atomic<size_t> lock_count_;
+  // The table never shrinks below its initial or reserved bucket count, nor
+  // below the lock count. It only changes while all the locks are held.
+  std::atomic<size_t> min_bucket_count_;
+  // The element count is sharded by hash, so that operations on separate
+  // buckets mostly update separate cache lines.
+  ShardedCounter elem_count_;
+  // A vector of as many mutexes as the lock count can grow to, the first
+  // |lock_count_| of which are in use. Bucket i is guarded by the mutex
+  // i % |lock_count_|. By default each mutex is padded to a cache line, so
+  // that threads on different stripes do not share one.
+  std::vector<StripeMutex> mutexes_;
+  // An allocator for the buckets of each lock, used under that lock.
+  std::vector<Allocator> allocators_;
+  const ResizeMode resize_mode_;
+  const ResizePolicy resize_policy_;
+  // During an incremental resize, the table the elements are migrated from.
+  // It only changes while all the locks are held, and each of its buckets is
+  // guarded by the same lock as the new buckets its elements move to.
+  Table old_table_;
+  size_t old_bucket_count_;
+  // The next old bucket to migrate for each lock. The old buckets of the lock
+  // i are i, i + |lock_count_|, i + 2 * |lock_count_|, etc.
+  std::vector<size_t> cursors_;
+
+  // The number of old buckets an operation migrates on top of the old bucket
+  // of its element, so that quiet buckets get migrated as well.
+  static constexpr size_t kMigrationStep = 2;
+  // The number of elements worth starting another thread for when a
+  // stop-the-world resize rehashes them, or a bulk build adds them.
+  static constexpr size_t kMinElemsPerThread = 1 << 16;
+  // The number of elements of a batch whose locks are taken together. Taking
+  // each lock once per slice rather than once per batch keeps a lock from
+  // being held for a whole batch, and keeps a slice of keys that hash to
+  // nearby buckets, such as consecutive integers, in cache while its locks
+  // are visited in turn.
+  static constexpr size_t kBatchSliceSize = 1024;
+
+  StatsRecorder stats_;
+
+  // Add, Remove and Contains once |key| is hashed to |hash|.
+  template <typename U> bool AddHashed(U &&elem, size_t hash) {
+    if (!WithStripeLock<std::scoped_lock<StripeMutex>>(
+            hash, [&](size_t my_lock) {
+              return AddNoLock(std::forward<U>(elem), hash, my_lock);
+            })) {
+      return false;
+    }
+    ResizeIfDue(hash);
+    return true;
+  }
+
+  // The element removed is only destroyed once the lock is released.
+  template <typename K> bool RemoveHashed(const K &key, size_t hash) {
+    std::optional<T> removed;
+    WithStripeLock<std::scoped_lock<StripeMutex>>(hash, [&](size_t my_lock) {
+      removed = RemoveNoLock(key, hash, my_lock);
+      return removed.has_value();
+    });
+    if (!removed.has_value()) {
+      return false;
+    }
+    removed.reset();
+    ResizeIfDue(hash);
+    return true;
+  }
+
+  template <typename K> bool ContainsHashed(const K &key, size_t hash) {
+    return WithStripeLock<ScopedReaderLock<StripeMutex>>(
+        hash,
+        [&](size_t my_lock) { return ContainsReader(key, hash, my_lock); });
+  }
+
+  // Resizes the table if the policy says so, once an operation on the
+  // element with |hash| changed the element count. The caller holds no lock.
+  void ResizeIfDue(size_t hash) {
+    if (ShardPolicy(hash) && Policy()) {
+      stats_.PolicyTriggered();
+      Resize();
+    }
+  }
+
+  // Grows the table, in a single resize, to the size it would grow to while
+  // the element count reached |elem_count|. Unlike Reserve, it lets the table
+  // shrink back below that size.
+  void GrowFor(size_t elem_count) {
+    size_t bucket_count = bucket_count_.load();
+    if (resize_policy_.BucketCountFor(elem_count, bucket_count) ==
+        bucket_count) {
+      return;
+    }
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    ScopedVectorLock<StripeMutex> scopedLockVector(mutexes_);
+    bucket_count = bucket_count_.load();
+    size_t new_capacity =
+        resize_policy_.BucketCountFor(elem_count, bucket_count);
+    if (new_capacity != bucket_count) {
+      ResizeTo(new_capacity, begin_time);
+    }
+  }
+
+  // Returns the element of |bucket| equal to |key|, or null.
+  template <typename K> static T *BucketFind(Bucket &bucket, const K &key) {
+    auto it = std::find(bucket.begin(), bucket.end(), key);
+    return it != bucket.end() ? &*it : nullptr;
+  }
 
-  bool ContainsNoLock(T elem, size_t my_bucket) {
-    std::vector<T> small_table = table_[my_bucket];
-    return std::find(small_table.begin(), small_table.end(), elem) !=
-           small_table.end();
+  // The caller holds the lock |my_lock| of |key|, whose hash is |hash|,
+  // possibly only for reading, in which case we must not migrate. The old
+  // bucket of |key| may then still hold it, until the migration of the lock
+  // is done.
+  template <typename K>
+  const T *FindReader(const K &key, size_t hash, size_t my_lock) {
+    if constexpr (!IsSharedMutex<Mutex>::value) {
+      Migrate(my_lock, hash);
+    }
+    T *elem = BucketFind(table_[BucketIndex(hash, bucket_count_.load())], key);
+    if (elem != nullptr || cursors_[my_lock] >= old_bucket_count_) {
+      return elem;
+    }
+    return BucketFind(old_table_[BucketIndex(hash, old_bucket_count_)], key);
+  }
+
+  template <typename K>
+  bool ContainsReader(const K &key, size_t hash, size_t my_lock) {
+    return FindReader(key, hash, my_lock) != nullptr;
+  }
+
+  // The caller holds the lock |my_lock| of |key|, whose hash is |hash|, for
+  // writing. Migrates the old bucket of |key|, and returns the element equal
+  // to it, which may then be modified in place as long as it stays equal.
+  template <typename K>
+  T *FindNoLock(const K &key, size_t hash, size_t my_lock) {
+    Migrate(my_lock, hash);
+    return BucketFind(table_[BucketIndex(hash, bucket_count_.load())], key);
+  }
+
+  // Adds |elem|, which FindNoLock did not find under the same lock, and
+  // counts it in its shard.
+  template <typename U> void InsertNoLock(U &&elem, size_t hash) {
+    table_[BucketIndex(hash, bucket_count_.load())].push_back(
+        std::forward<U>(elem));
+    elem_count_.Add(elem_count_.ShardOf(hash));
+  }
+
+  // The caller holds the lock |my_lock| of |elem|, whose hash is |hash|.
+  template <typename U>
+  bool AddNoLock(U &&elem, size_t hash, size_t my_lock) {
+    if (FindNoLock(elem, hash, my_lock) != nullptr) {
+      return false;
+    }
+    InsertNoLock(std::forward<U>(elem), hash);
+    return true;
+  }
+
+  // Returns the element removed, if any. The order of a bucket does not
+  // matter, so the last element fills the hole instead of every later element
+  // shifting down.
+  template <typename K>
+  std::optional<T> RemoveNoLock(const K &key, size_t hash, size_t my_lock) {
+    Migrate(my_lock, hash);
+    Bucket &bucket = table_[BucketIndex(hash, bucket_count_.load())];
+    auto it = std::find(bucket.begin(), bucket.end(), key);
+    if (it == bucket.end()) {
+      return std::nullopt;
+    }
+    size_t shard = elem_count_.ShardOf(hash);
+    assert(elem_count_.Get(shard) != 0);
+    std::optional<T> removed(std::move(*it));
+    if (it != bucket.end() - 1) {
+      *it = std::move(bucket.back());
+    }
+    bucket.pop_back();
+    elem_count_.Sub(shard);
+    return removed;
   }
 
-  bool Policy() { return (elem_count_.load() / bucket_count_.load()) > 4; }
+  // Runs |scan|, copying the elements of each lock it visits while holding
+  // the lock for reading, and calling |visit| on them after. The old buckets
+  // of a lock are guarded by it as well.
+  template <typename Visit> void ScanStripes(StripeScan &scan, Visit visit) {
+    std::vector<T> elems;
+    while (!scan.Done()) {
+      elems.clear();
+      WithStripeLock<ScopedReaderLock<StripeMutex>>(
+          scan.Next(), [&](size_t my_lock) {
+            size_t lock_count = lock_count_.load();
+            bool whole = scan.VisitsWholeLock(my_lock, lock_count);
+            for (const Table *table : {&table_, &old_table_}) {
+              for (size_t i = my_lock; i < table->size(); i += lock_count) {
+                for (const T &elem : (*table)[i]) {
+                  if (whole || scan.Visits(hash_(elem))) {
+                    elems.push_back(elem);
+                  }
+                }
+              }
+            }
+            scan.MarkVisited(my_lock, lock_count);
+            return true;
+          });
+      for (const T &elem : elems) {
+        visit(elem);
+      }
+    }
+  }
+
+  // Groups the indices of each slice of kBatchSliceSize elements of |elems|
+  // by lock, see PartGroups, and calls |fn| with the lock, the index and the
+  // hash of each element, taking each lock once per slice, with a |Lock|
+  // guard, for all of its elements. The elements of a lock are visited in
+  // their order in |elems|, and the locks from the first one of the thread
+  // on, see FirstGroupOfThread.
+  template <typename Lock, typename Fn>
+  void LockEachStripeOnce(const std::vector<T> &elems, Fn fn) {
+    std::vector<size_t> hashes(elems.size());
+    for (size_t i = 0; i < elems.size(); i++) {
+      hashes[i] = hash_(elems[i]);
+    }
+    std::vector<size_t> pending;
+    for (size_t begin = 0; begin < elems.size(); begin += kBatchSliceSize) {
+      pending.resize(std::min(kBatchSliceSize, elems.size() - begin));
+      std::iota(pending.begin(), pending.end(), begin);
+      while (!pending.empty()) {
+        size_t lock_count = lock_count_.load();
+        PartGroups groups(pending, lock_count, [&](size_t i) {
+          return BucketIndex(hashes[i], lock_count);
+        });
+        size_t group_count = groups.GroupCount();
+        size_t first = FirstGroupOfThread(group_count);
+        size_t step = 0;
+        for (; step < group_count; step++) {
+          PartGroups::Group group = groups.After(first, step);
+          Lock lock(mutexes_[group.Part()]);
+          if (lock_count_.load() != lock_count) {
+            break;
+          }
+          for (size_t i : group) {
+            fn(group.Part(), i, hashes[i]);
+          }
+        }
+        // Locks were added while we waited, so we group the elements left by
+        // their new locks, in their order in |elems|.
+        pending.clear();
+        for (; step < group_count; step++) {
+          PartGroups::Group group = groups.After(first, step);
+          pending.insert(pending.end(), group.begin(), group.end());
+        }
+        std::sort(pending.begin(), pending.end());
+      }
+    }
+  }
+
+  // Calls |fn| with the lock of |hash| while holding it with a |Lock| guard,
+  // and returns what it returns.
+  template <typename Lock, typename Fn>
+  bool WithStripeLock(size_t hash, Fn fn) {
+    while (true) {
+      size_t lock_count = lock_count_.load();
+      size_t my_lock = BucketIndex(hash, lock_count);
+      Lock lock(mutexes_[my_lock]);
+      if (lock_count_.load() == lock_count) {
+        return fn(my_lock);
+      }
+    }
+  }
+
+  bool Policy() {
+    size_t bucket_count = bucket_count_.load();
+    return NewBucketCount(elem_count_.Sum(), bucket_count) != bucket_count;
+  }
+
+  // The same policy, but estimated from the load of the shard of the element
+  // with |hash| alone, so that Add and Remove only sum the whole element count
+  // once their shard looks due for a resize.
+  bool ShardPolicy(size_t hash) {
+    size_t shard = elem_count_.ShardOf(hash);
+    size_t bucket_count = bucket_count_.load();
+    return NewBucketCount(elem_count_.Get(shard) * elem_count_.ShardCount(),
+                          bucket_count) != bucket_count;
+  }
+
+  size_t NewBucketCount(size_t elem_count, size_t bucket_count) {
+    return resize_policy_.TargetBucketCount(elem_count, bucket_count,
+                                            min_bucket_count_.load());
+  }
 
   // When resizing we have to stop all other operations so we first lock the
   // whole vector of mutexes using our custom scoped vector lock.
   void Resize() {
     size_t old_capacity = bucket_count_.load();
-    ScopedVectorLock scopedLockVector(mutexes_);
+    StatsRecorder::TimePoint begin_time = stats_.Now();
+    ScopedVectorLock<StripeMutex> scopedLockVector(mutexes_);
+    // Locking every stripe is how the striped set quiesces.
+    stats_.Quiesced(begin_time);
     // This is to ensure we are not resizing more than once at a time.
     if (old_capacity != bucket_count_.load()) {
       return;
     }
-    size_t new_capacity = 2 * old_capacity;
+    // With all the locks held the element count is exact, so we check the
+    // policy again.
+    size_t new_capacity = NewBucketCount(elem_count_.Sum(), old_capacity);
+    if (new_capacity == old_capacity) {
+      return;
+    }
+    ResizeTo(new_capacity, begin_time);
+  }
+
+  // Resizes the table to |new_capacity| buckets, together with the lock
+  // count. The caller holds all the locks.
+  void ResizeTo(size_t new_capacity, StatsRecorder::TimePoint begin_time) {
+    size_t lock_count = lock_count_.load();
+    size_t new_lock_count =
+        resize_policy_.TargetLockCount(new_capacity, lock_count);
+    // The old buckets of a lock would be shared by several of the new locks,
+    // so the few resizes that add locks move every element right away.
+    if (resize_mode_ == ResizeMode::kIncremental &&
+        new_lock_count == lock_count) {
+      StartMigration(new_capacity);
+      stats_.Resized(begin_time);
+      return;
+    }
+    FinishMigration();
+    lock_count_.store(new_lock_count);
+    min_bucket_count_.store(std::max(min_bucket_count_.load(), new_lock_count));
     bucket_count_.store(new_capacity);
-    std::vector<std::vector<T>> table;
-    table.resize(new_capacity);
-    for (size_t i = 0; i < new_capacity; i++) {
-      table[i] = std::vector<T>();
-    }
-    for (std::vector<T> bucket : table_) {
-      for (T elem : bucket) {
-        table[std::hash<T>()(elem) % new_capacity].push_back(elem);
+    Table table = MakeTable(new_capacity);
+    size_t elem_count = elem_count_.Sum();
+    ParallelFor(lock_count,
+                ThreadCountFor(elem_count, kMinElemsPerThread),
+                [&](size_t begin, size_t end) {
+                  RehashStripes(begin, end, lock_count, table,
+                                elem_count / new_capacity + 1);
+                });
+    table_.swap(table);
+    stats_.Resized(begin_time);
+  }
+
+  // Moves the elements of the buckets of the old locks in [begin, end), out
+  // of |lock_count|, into |table|, whose buckets congruent to those locks are
+  // sized to |bucket_size| first, and frees the old buckets. The caller holds
+  // all the locks.
+  //
+  // Both bucket counts, and the new lock count, are multiples of the old lock
+  // count, so an element moves between buckets congruent modulo it.
+  // Stop-the-world resizes of large tables hand each of a few threads some
+  // of the old locks, which then only touch their own buckets, and the
+  // allocators of the locks congruent to theirs. We move rather than copy
+  // the elements, and size the new buckets for the average load, to keep the
+  // time all the locks are held short.
+  void RehashStripes(size_t begin, size_t end, size_t lock_count, Table &table,
+                     size_t bucket_size) {
+    for (size_t first = 0; first < table.size(); first += lock_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        table[i].reserve(bucket_size);
+      }
+    }
+    for (size_t first = 0; first < table_.size(); first += lock_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        for (T &elem : table_[i]) {
+          table[BucketIndex(hash_(elem), table.size())].push_back(
+              std::move(elem));
+        }
+        table_[i].clear();
+        table_[i].shrink_to_fit();
       }
     }
-    table_ = table;
+  }
+
+  // Makes the current table the old one, after moving the old buckets that
+  // were not migrated yet into it. The caller holds all the locks.
+  void StartMigration(size_t new_capacity) {
+    FinishMigration();
+    old_table_ = std::move(table_);
+    old_bucket_count_ = bucket_count_.load();
+    table_ = MakeTable(new_capacity);
+    bucket_count_.store(new_capacity);
+    for (size_t i = 0; i < lock_count_.load(); i++) {
+      cursors_[i] = i;
+    }
+  }
+
+  // Moves the old buckets that were not migrated yet into the table, and
+  // drops the old table. The caller holds all the locks.
+  void FinishMigration() {
+    for (size_t i = 0; i < old_bucket_count_; i++) {
+      MigrateBucket(i);
+    }
+    old_table_.clear();
+    old_bucket_count_ = 0;
+  }
+
+  // The caller holds the lock |my_lock| of the element with |hash|. We
+  // migrate the old bucket of the element, so that the operation only has to
+  // look at the new table, and then a few more old buckets of the same lock.
+  void Migrate(size_t my_lock, size_t hash) {
+    if (cursors_[my_lock] >= old_bucket_count_) {
+      return;
+    }
+    MigrateBucket(BucketIndex(hash, old_bucket_count_));
+    for (size_t i = 0;
+         i < kMigrationStep && cursors_[my_lock] < old_bucket_count_; i++) {
+      MigrateBucket(cursors_[my_lock]);
+      cursors_[my_lock] += lock_count_.load();
+    }
+  }
+
+  void MigrateBucket(size_t old_bucket) {
+    if (old_table_[old_bucket].empty()) {
+      return;
+    }
+    size_t new_capacity = bucket_count_.load();
+    for (T &elem : old_table_[old_bucket]) {
+      table_[BucketIndex(hash_(elem), new_capacity)].push_back(
+          std::move(elem));
+    }
+    old_table_[old_bucket].clear();
+    old_table_[old_bucket].shrink_to_fit();
+  }
+
+  // Makes |bucket_count| empty buckets, each with the allocator of its lock.
+  Table MakeTable(size_t bucket_count) {
+    Table table(table_allocator_);
+    table.reserve(bucket_count);
+    size_t lock_count = lock_count_.load();
+    for (size_t i = 0; i < bucket_count; i++) {
+      table.emplace_back(allocators_[BucketIndex(i, lock_count)]);
+    }
+    return table;
   }
 };
 
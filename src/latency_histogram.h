@@ -0,0 +1,130 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace benchmark {
+
+/*
+ * A histogram of latencies in nanoseconds, in the style of an HDR histogram:
+ * the latencies below kSubBucketCount get a bucket each, and every further
+ * power of two is split into kSubBucketCount buckets of equal width, so that
+ * a bucket is never wider than 1/kSubBucketCount of the latencies it holds.
+ * Recording is a couple of shifts and an increment, and histograms of
+ * different threads are merged by adding their buckets up.
+ */
+class LatencyHistogram {
+public:
+  void Record(uint64_t nanos) {
+    counts_[BucketOf(nanos)]++;
+    count_++;
+    max_ = std::max(max_, nanos);
+  }
+
+  void Merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < kBucketCount; i++) {
+      counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  [[nodiscard]] uint64_t Count() const { return count_; }
+
+  [[nodiscard]] uint64_t Max() const { return max_; }
+
+  // Returns the latency that |quantile| of the recorded latencies do not
+  // exceed, rounded up to the upper bound of its bucket.
+  [[nodiscard]] uint64_t Percentile(double quantile) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(
+        std::ceil(quantile * static_cast<double>(count_)));
+    rank = std::clamp<uint64_t>(rank, 1, count_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(UpperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static constexpr size_t kSubBucketBits = 5;
+  static constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+  // The linear buckets, and then kSubBucketCount buckets for each power of
+  // two from 2^kSubBucketBits up to 2^63.
+  static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) *
+                                         kSubBucketCount;
+
+  std::array<uint64_t, kBucketCount> counts_{};
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+
+  static size_t BucketOf(uint64_t nanos) {
+    if (nanos < kSubBucketCount) {
+      return static_cast<size_t>(nanos);
+    }
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(nanos));
+    size_t shift = exponent - kSubBucketBits;
+    size_t sub_bucket = static_cast<size_t>(nanos >> shift) - kSubBucketCount;
+    return (shift + 1) * kSubBucketCount + sub_bucket;
+  }
+
+  static uint64_t UpperBound(size_t bucket) {
+    if (bucket < kSubBucketCount) {
+      return bucket;
+    }
+    size_t shift = bucket / kSubBucketCount - 1;
+    uint64_t sub_bucket = bucket % kSubBucketCount;
+    return ((kSubBucketCount + sub_bucket + 1) << shift) - 1;
+  }
+};
+
+// The latencies of each operation type of one thread, or of a whole run once
+// merged.
+struct OperationLatencies {
+  LatencyHistogram add;
+  LatencyHistogram remove;
+  LatencyHistogram contains;
+
+  void Merge(const OperationLatencies &other) {
+    add.Merge(other.add);
+    remove.Merge(other.remove);
+    contains.Merge(other.contains);
+  }
+};
+
+// Returns the |histogram| member of |latencies|, or null if |latencies| is
+// null because the latencies are not recorded.
+inline LatencyHistogram *
+HistogramOf(OperationLatencies *latencies,
+            LatencyHistogram OperationLatencies::*histogram) {
+  return latencies == nullptr ? nullptr : &(latencies->*histogram);
+}
+
+// Calls |fn| and records how long it took in |histogram|, unless |histogram|
+// is null, in which case the clock is not read at all.
+template <typename Fn> auto Timed(LatencyHistogram *histogram, Fn fn) {
+  if (histogram == nullptr) {
+    return fn();
+  }
+  auto begin = std::chrono::steady_clock::now();
+  auto result = fn();
+  auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - begin);
+  histogram->Record(static_cast<uint64_t>(nanos.count()));
+  return result;
+}
+
+} // namespace benchmark
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,50 @@
+#ifndef MAP_ENTRY_H
+#define MAP_ENTRY_H
+
+#include <cstddef>
+#include <utility>
+
+/*
+ * An entry of the hash maps, stored as an element of the hash set they are
+ * built on. Entries compare equal, and are hashed by MapEntryHash, by their
+ * key alone, so that the set finds the entry of a key, and the value may
+ * change in place without moving the entry.
+ */
+template <typename K, typename V> struct MapEntry {
+  K key;
+  V value;
+
+  friend bool operator==(const MapEntry &lhs, const MapEntry &rhs) {
+    return lhs.key == rhs.key;
+  }
+
+  // An entry also compares equal to a key equal to its own, so that the set
+  // looks entries up by key without constructing one.
+  template <typename Key>
+  friend bool operator==(const MapEntry &entry, const Key &key) {
+    return entry.key == key;
+  }
+};
+
+// Hashes an entry as |Hash| hashes its key. It is transparent, see
+// IsTransparent in hash_functions.h, so that the set hashes keys as well,
+// which the maps only pass to it with the types that |Hash| takes.
+template <typename K, typename V, typename Hash> class MapEntryHash {
+public:
+  using is_transparent = void;
+
+  explicit MapEntryHash(Hash hash = Hash()) : hash_(std::move(hash)) {}
+
+  size_t operator()(const MapEntry<K, V> &entry) const {
+    return hash_(entry.key);
+  }
+
+  template <typename Key> size_t operator()(const Key &key) const {
+    return hash_(key);
+  }
+
+private:
+  Hash hash_;
+};
+
+#endif // MAP_ENTRY_H
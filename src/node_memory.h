@@ -0,0 +1,96 @@
+#ifndef NODE_MEMORY_H
+#define NODE_MEMORY_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "src/numa_topology.h"
+#include "src/slab_allocator.h"
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Memory placed on one NUMA node, whichever thread first touches it. Each
+ * request is mapped anonymously, rounded up to whole pages, and the mapping is
+ * bound to the node with mbind before any of its pages is touched, so the
+ * kernel allocates them there when they are. The policy is MPOL_PREFERRED:
+ * should the node run out of memory, the pages come from another node rather
+ * than the process failing.
+ *
+ * A mapping per request only suits large requests, so NodeMemory is meant to
+ * back a SlabPool, which asks it for slabs and for the blocks too large for
+ * them: a NodeAllocator. Where there is no mbind, as outside Linux, or where
+ * the system refuses it, the memory is left to the usual first-touch policy.
+ */
+class NodeMemory {
+public:
+  // The memory of the node the constructing thread runs on, such as that of
+  // the thread HashSetNuma pins to a node to construct its shard.
+  NodeMemory() : node_(CurrentNode()) {}
+
+  explicit NodeMemory(size_t node) : node_(node) {}
+
+  [[nodiscard]] size_t Node() const { return node_; }
+
+  void *Allocate(size_t bytes, size_t align) {
+#if defined(__linux__)
+    if (align <= PageSize()) {
+      size_t length = MappedLength(bytes);
+      void *memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (memory == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      BindToNode(memory, length);
+      return memory;
+    }
+#endif
+    return ::operator new(bytes, std::align_val_t(align));
+  }
+
+  void Deallocate(void *memory, size_t bytes, size_t align) {
+#if defined(__linux__)
+    if (align <= PageSize()) {
+      munmap(memory, MappedLength(bytes));
+      return;
+    }
+#endif
+    ::operator delete(memory, bytes, std::align_val_t(align));
+  }
+
+private:
+  size_t node_;
+
+#if defined(__linux__)
+  static size_t PageSize() {
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+  }
+
+  static size_t MappedLength(size_t bytes) {
+    return (bytes + PageSize() - 1) / PageSize() * PageSize();
+  }
+
+  // Should the system refuse, the pages are placed on first touch.
+  void BindToNode(void *memory, size_t length) const {
+    constexpr size_t kBitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node_ / kBitsPerWord + 1, 0);
+    mask[node_ / kBitsPerWord] |= 1UL << (node_ % kBitsPerWord);
+    // The kernel reads one bit fewer than |maxnode| says.
+    syscall(SYS_mbind, memory, length, MPOL_PREFERRED, mask.data(), node_ + 2,
+            0);
+  }
+#endif
+};
+
+// A SlabAllocator whose slabs, and larger blocks, are placed on the node of
+// the thread that constructed it.
+template <typename T> using NodeAllocator = SlabAllocator<T, NodeMemory>;
+
+#endif // NODE_MEMORY_H
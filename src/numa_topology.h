@@ -0,0 +1,155 @@
+#ifndef NUMA_TOPOLOGY_H
+#define NUMA_TOPOLOGY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * The NUMA nodes of the machine and the CPUs of each, read from sysfs, and
+ * the means to pin the calling thread to some of them. Where there is no
+ * sysfs node directory, as outside Linux, the machine is taken to be a single
+ * node with every CPU, and pinning does nothing.
+ */
+class NumaTopology {
+public:
+  // The topology of this machine, read once.
+  static const NumaTopology &Get() {
+    static const NumaTopology topology;
+    return topology;
+  }
+
+  [[nodiscard]] size_t NodeCount() const { return node_cpus_.size(); }
+
+  [[nodiscard]] const std::vector<size_t> &CpusOf(size_t node) const {
+    return node_cpus_[node];
+  }
+
+  // Every CPU, those of node 0 first, then those of node 1, etc.
+  [[nodiscard]] const std::vector<size_t> &AllCpus() const {
+    return all_cpus_;
+  }
+
+private:
+  std::vector<std::vector<size_t>> node_cpus_;
+  std::vector<size_t> all_cpus_;
+
+  NumaTopology() {
+    std::vector<size_t> nodes;
+    if (ReadList("/sys/devices/system/node/online", nodes)) {
+      for (size_t node : nodes) {
+        std::vector<size_t> cpus;
+        std::string path = "/sys/devices/system/node/node" +
+                           std::to_string(node) + "/cpulist";
+        // A node may have memory but no CPUs.
+        if (ReadList(path, cpus) && !cpus.empty()) {
+          node_cpus_.push_back(cpus);
+        }
+      }
+    }
+    if (node_cpus_.empty()) {
+      size_t cpu_count =
+          std::max<size_t>(std::thread::hardware_concurrency(), 1);
+      std::vector<size_t> cpus;
+      for (size_t cpu = 0; cpu < cpu_count; cpu++) {
+        cpus.push_back(cpu);
+      }
+      node_cpus_.push_back(cpus);
+    }
+    for (const std::vector<size_t> &cpus : node_cpus_) {
+      all_cpus_.insert(all_cpus_.end(), cpus.begin(), cpus.end());
+    }
+  }
+
+  // Reads a sysfs list such as "0-3,8-11" from |path| into |values|.
+  static bool ReadList(const std::string &path, std::vector<size_t> &values) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file || !std::getline(file, line)) {
+      return false;
+    }
+    std::stringstream ranges(line);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      size_t dash = range.find('-');
+      try {
+        size_t first = std::stoul(range.substr(0, dash));
+        size_t last = dash == std::string::npos
+                          ? first
+                          : std::stoul(range.substr(dash + 1));
+        for (size_t value = first; value <= last; value++) {
+          values.push_back(value);
+        }
+      } catch (const std::logic_error &) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Restricts the calling thread to |cpus|. Returns false if the system refused,
+// or does not support pinning.
+inline bool PinThreadToCpus(const std::vector<size_t> &cpus) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+// The node the calling thread is running on, as the kernel numbers it, which
+// is also the number mbind takes. It is 0 where the system cannot tell.
+inline size_t CurrentNode() {
+#if defined(__linux__)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif
+  return 0;
+}
+
+// How the benchmark spreads its threads over the machine.
+enum class ThreadPinning {
+  // The scheduler places the threads.
+  kNone,
+  // Thread i runs on CPU i, wrapping around, with the CPUs of node 0 first.
+  kCores,
+  // Thread i runs on any CPU of node i, wrapping around.
+  kNodes,
+};
+
+// Pins the calling thread, the |index|th of the benchmark, as |pinning| says.
+inline void PinThread(ThreadPinning pinning, size_t index) {
+  const NumaTopology &topology = NumaTopology::Get();
+  if (pinning == ThreadPinning::kCores) {
+    const std::vector<size_t> &cpus = topology.AllCpus();
+    PinThreadToCpus({cpus[index % cpus.size()]});
+  } else if (pinning == ThreadPinning::kNodes) {
+    PinThreadToCpus(topology.CpusOf(index % topology.NodeCount()));
+  }
+}
+
+#endif // NUMA_TOPOLOGY_H
@@ -0,0 +1,86 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+// The number of threads worth splitting |work| items over, when each thread
+// should get at least |min_work_per_thread| of them to pay for starting it: at
+// least one, and at most one per hardware thread.
+inline size_t ThreadCountFor(size_t work, size_t min_work_per_thread) {
+  size_t hardware_threads =
+      std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  return std::clamp<size_t>(work / min_work_per_thread, 1, hardware_threads);
+}
+
+// Calls |fn(begin, end)| on |thread_count| disjoint ranges that together cover
+// [0, count), one on the calling thread and the others on helper threads, and
+// returns once all of them are done.
+template <typename Fn>
+void ParallelFor(size_t count, size_t thread_count, const Fn &fn) {
+  thread_count = std::max<size_t>(std::min(thread_count, count), 1);
+  size_t chunk = (count + thread_count - 1) / thread_count;
+  std::vector<std::thread> helpers;
+  helpers.reserve(thread_count - 1);
+  for (size_t begin = chunk; begin < count; begin += chunk) {
+    helpers.emplace_back(
+        [&fn, begin, end = std::min(count, begin + chunk)] { fn(begin, end); });
+  }
+  fn(0, std::min(count, chunk));
+  for (std::thread &helper : helpers) {
+    helper.join();
+  }
+}
+
+// Calls |fn(i)| for every i in [0, count), on up to |thread_count| threads,
+// and returns the number of calls that returned true. Every i of the same
+// part |part_of(i)|, in [0, part_count), is handed to the same thread, which
+// calls |fn| on its indices in increasing order. The indices are sorted out
+// by thread in a first parallel pass, so neither pass has a thread look at
+// more than a slice of them.
+template <typename PartOf, typename Fn>
+size_t ParallelForEachPart(size_t count, size_t part_count,
+                           size_t thread_count, const PartOf &part_of,
+                           const Fn &fn) {
+  thread_count = std::max<size_t>(std::min(thread_count, part_count), 1);
+  if (thread_count == 1) {
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (fn(i)) {
+        hits++;
+      }
+    }
+    return hits;
+  }
+  size_t parts_per_thread = (part_count + thread_count - 1) / thread_count;
+  size_t slice_size = (count + thread_count - 1) / thread_count;
+  // The indices of each slice of [0, count), by the thread of their part.
+  std::vector<std::vector<std::vector<size_t>>> slices(
+      thread_count, std::vector<std::vector<size_t>>(thread_count));
+  ParallelFor(thread_count, thread_count, [&](size_t begin, size_t end) {
+    for (size_t slice = begin; slice < end; slice++) {
+      size_t last = std::min(count, (slice + 1) * slice_size);
+      for (size_t i = slice * slice_size; i < last; i++) {
+        slices[slice][part_of(i) / parts_per_thread].push_back(i);
+      }
+    }
+  });
+  std::vector<size_t> hits(thread_count, 0);
+  ParallelFor(thread_count, thread_count, [&](size_t begin, size_t end) {
+    for (size_t thread = begin; thread < end; thread++) {
+      for (const std::vector<std::vector<size_t>> &slice : slices) {
+        for (size_t i : slice[thread]) {
+          if (fn(i)) {
+            hits[thread]++;
+          }
+        }
+      }
+    }
+  });
+  return std::accumulate(hits.begin(), hits.end(), size_t{0});
+}
+
+#endif // PARALLEL_FOR_H
@@ -0,0 +1,130 @@
+#ifndef PART_GROUPS_H
+#define PART_GROUPS_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "src/hash_functions.h"
+
+/*
+ * Indices grouped by part, as the batch operations of the striped sets group
+ * the elements of a batch by lock. A counting sort groups n indices in
+ * O(n + parts) time: one pass counts the indices of each part, and a second
+ * one places them, leaving out the empty parts. With more parts than
+ * indices, such as for a small batch on a table with a lock per bucket,
+ * counting would cost more than the batch itself while few parts have more
+ * than an index, so the indices are only split into runs of the same part
+ * instead, and a part may have several groups. Either way, the indices of a
+ * group keep their order.
+ */
+class PartGroups {
+public:
+  // The indices of a part, in their order in the grouped indices.
+  class Group {
+  public:
+    using Iterator = std::vector<size_t>::const_iterator;
+
+    Group(size_t part, Iterator begin, Iterator end)
+        : part_(part), begin_(begin), end_(end) {}
+
+    [[nodiscard]] size_t Part() const { return part_; }
+    [[nodiscard]] Iterator begin() const { return begin_; }
+    [[nodiscard]] Iterator end() const { return end_; }
+    [[nodiscard]] size_t size() const {
+      return static_cast<size_t>(end_ - begin_);
+    }
+
+  private:
+    size_t part_;
+    Iterator begin_;
+    Iterator end_;
+  };
+
+  // Groups |indices|, a vector of indices or a Group, by |part_of(i)|, which
+  // is in [0, part_count).
+  template <typename Indices, typename PartOf>
+  PartGroups(const Indices &indices, size_t part_count, const PartOf &part_of)
+      : indices_(indices.size()) {
+    if (part_count <= indices.size()) {
+      CountingSort(indices, part_count, part_of);
+    } else {
+      SplitRuns(indices, part_of);
+    }
+  }
+
+  [[nodiscard]] size_t GroupCount() const { return parts_.size(); }
+
+  [[nodiscard]] Group Of(size_t group) const {
+    auto begin = indices_.begin();
+    return Group(parts_[group],
+                 begin + static_cast<std::ptrdiff_t>(offsets_[group]),
+                 begin + static_cast<std::ptrdiff_t>(offsets_[group + 1]));
+  }
+
+  // The group |step| groups after the group |first|, wrapping around, for a
+  // pass over the groups that starts at |first|. Both are below GroupCount().
+  [[nodiscard]] Group After(size_t first, size_t step) const {
+    size_t group = first + step;
+    return Of(group < GroupCount() ? group : group - GroupCount());
+  }
+
+private:
+  // The part of each group, and the offset of its first index in |indices_|,
+  // with the end of the last group as an extra offset.
+  std::vector<size_t> parts_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> indices_;
+
+  template <typename Indices, typename PartOf>
+  void CountingSort(const Indices &indices, size_t part_count,
+                    const PartOf &part_of) {
+    std::vector<size_t> next(part_count, 0);
+    for (size_t i : indices) {
+      next[part_of(i)]++;
+    }
+    size_t offset = 0;
+    for (size_t part = 0; part < part_count; part++) {
+      size_t count = next[part];
+      next[part] = offset;
+      if (count != 0) {
+        parts_.push_back(part);
+        offsets_.push_back(offset);
+        offset += count;
+      }
+    }
+    offsets_.push_back(offset);
+    for (size_t i : indices) {
+      indices_[next[part_of(i)]++] = i;
+    }
+  }
+
+  template <typename Indices, typename PartOf>
+  void SplitRuns(const Indices &indices, const PartOf &part_of) {
+    parts_.reserve(indices.size());
+    offsets_.reserve(indices.size() + 1);
+    size_t k = 0;
+    for (size_t i : indices) {
+      size_t part = part_of(i);
+      if (parts_.empty() || parts_.back() != part) {
+        parts_.push_back(part);
+        offsets_.push_back(k);
+      }
+      indices_[k++] = i;
+    }
+    offsets_.push_back(k);
+  }
+};
+
+// The group out of |group_count| at which the calling thread starts a pass
+// over the groups. Threads that each lock the groups of a batch in turn then
+// start at different locks, rather than queueing behind each other from the
+// first.
+inline size_t FirstGroupOfThread(size_t group_count) {
+  return BucketIndex(
+      MixHash(std::hash<std::thread::id>()(std::this_thread::get_id())),
+      group_count);
+}
+
+#endif // PART_GROUPS_H
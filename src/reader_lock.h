@@ -0,0 +1,51 @@
+#ifndef READER_LOCK_H
+#define READER_LOCK_H
+
+#include <type_traits>
+#include <utility>
+
+// Whether |Mutex| can be locked for reading, such as std::shared_mutex.
+template <typename Mutex, typename = void>
+struct IsSharedMutex : std::false_type {};
+
+template <typename Mutex>
+struct IsSharedMutex<
+    Mutex, std::void_t<decltype(std::declval<Mutex &>().lock_shared()),
+                       decltype(std::declval<Mutex &>().unlock_shared())>>
+    : std::true_type {};
+
+// Locks |mutex| for reading, so that readers only exclude writers. A mutex
+// that cannot be shared is locked exclusively instead.
+template <typename Mutex> void LockForReading(Mutex &mutex) {
+  if constexpr (IsSharedMutex<Mutex>::value) {
+    mutex.lock_shared();
+  } else {
+    mutex.lock();
+  }
+}
+
+template <typename Mutex> void UnlockForReading(Mutex &mutex) {
+  if constexpr (IsSharedMutex<Mutex>::value) {
+    mutex.unlock_shared();
+  } else {
+    mutex.unlock();
+  }
+}
+
+// auxiliary class for locking a mutex for reading and unlocking it at the end
+// of the scope
+template <typename Mutex> class ScopedReaderLock {
+public:
+  explicit ScopedReaderLock(Mutex &mutex) : mutex_(mutex) {
+    LockForReading(mutex_);
+  }
+  ~ScopedReaderLock() { UnlockForReading(mutex_); }
+
+  ScopedReaderLock(const ScopedReaderLock &) = delete;
+  ScopedReaderLock &operator=(const ScopedReaderLock &) = delete;
+
+private:
+  Mutex &mutex_;
+};
+
+#endif // READER_LOCK_H
@@ -0,0 +1,223 @@
+#include "src/report.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace benchmark {
+
+namespace {
+
+struct NamedHistogram {
+  const char *name;
+  const LatencyHistogram *histogram;
+};
+
+constexpr double kQuantiles[] = {0.5, 0.99, 0.999};
+constexpr const char *kQuantileNames[] = {"p50", "p99", "p999"};
+
+size_t Throughput(const Report &report) {
+  int64_t millis = std::max<int64_t>(report.millis, 1);
+  return report.operations * 1000 / static_cast<size_t>(millis);
+}
+
+// Escapes the characters that cannot appear as is in a JSON string.
+std::string JsonString(const std::string &text) {
+  std::string result = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+#ifdef HASH_SET_STATS
+std::string JoinNumbers(const std::vector<size_t> &numbers) {
+  std::string result;
+  for (size_t i = 0; i < numbers.size(); i++) {
+    result += (i == 0 ? "" : ", ") + std::to_string(numbers[i]);
+  }
+  return result;
+}
+#endif
+
+// Quotes a CSV field if it contains a separator or a quote.
+std::string CsvField(const std::string &text) {
+  if (text.find_first_of(",\"") == std::string::npos) {
+    return text;
+  }
+  std::string result = "\"";
+  for (char c : text) {
+    if (c == '"') {
+      result += '"';
+    }
+    result += c;
+  }
+  return result + "\"";
+}
+
+#ifdef HASH_SET_STATS
+void PrintStatsText(const HashSetStats &stats, std::ostream &out) {
+  out << "Stats:" << std::endl;
+  out << "  lock acquisitions: " << stats.total_lock_acquisitions << ", "
+      << stats.total_contended_acquisitions << " contended, over "
+      << stats.lock_acquisitions.size() << " locks" << std::endl;
+  out << "  policy triggers: " << stats.policy_triggers << std::endl;
+  out << "  resizes: " << stats.resize_count << " in "
+      << stats.resize_time.count() << " ns" << std::endl;
+  out << "  quiesces: " << stats.quiesce_count << " in "
+      << stats.quiesce_time.count() << " ns" << std::endl;
+  out << "  bucket length: max " << stats.max_bucket_length << ", average "
+      << stats.average_bucket_length << std::endl;
+}
+
+void PrintStatsJson(const HashSetStats &stats, std::ostream &out) {
+  out << ", \"stats\": {\"lock_acquisitions\": ["
+      << JoinNumbers(stats.lock_acquisitions)
+      << "], \"contended_acquisitions\": ["
+      << JoinNumbers(stats.contended_acquisitions)
+      << "], \"total_lock_acquisitions\": " << stats.total_lock_acquisitions
+      << ", \"total_contended_acquisitions\": "
+      << stats.total_contended_acquisitions
+      << ", \"policy_triggers\": " << stats.policy_triggers
+      << ", \"resize_count\": " << stats.resize_count
+      << ", \"resize_ns\": " << stats.resize_time.count()
+      << ", \"quiesce_count\": " << stats.quiesce_count
+      << ", \"quiesce_ns\": " << stats.quiesce_time.count()
+      << ", \"max_bucket_length\": " << stats.max_bucket_length
+      << ", \"average_bucket_length\": " << stats.average_bucket_length
+      << "}";
+}
+#endif
+
+void PrintText(const Report &report,
+               const NamedHistogram (&histograms)[3], std::ostream &out) {
+  out << report.program << " succeeded" << std::endl;
+  if (report.description.empty()) {
+    out << "Concurrent computation took:" << std::endl;
+    out << "  " << report.millis << " ms" << std::endl;
+  } else {
+    out << report.description << ":" << std::endl;
+    out << "  " << report.operations << " operations in " << report.millis
+        << " ms" << std::endl;
+    out << "  " << Throughput(report) << " operations per second"
+        << std::endl;
+  }
+#ifdef HASH_SET_STATS
+  if (report.stats != nullptr) {
+    PrintStatsText(*report.stats, out);
+  }
+#endif
+  if (report.latencies == nullptr) {
+    return;
+  }
+  out << "Latency in ns:" << std::endl;
+  for (const NamedHistogram &named : histograms) {
+    const LatencyHistogram &histogram = *named.histogram;
+    out << "  " << named.name << ": count " << histogram.Count() << ", p50 "
+        << histogram.Percentile(0.5) << ", p99 " << histogram.Percentile(0.99)
+        << ", p99.9 " << histogram.Percentile(0.999) << ", max "
+        << histogram.Max() << std::endl;
+  }
+}
+
+void PrintJson(const Report &report,
+               const NamedHistogram (&histograms)[3], std::ostream &out) {
+  out << "{\"program\": " << JsonString(report.program)
+      << ", \"description\": " << JsonString(report.description)
+      << ", \"millis\": " << report.millis
+      << ", \"operations\": " << report.operations
+      << ", \"operations_per_second\": " << Throughput(report);
+  if (report.latencies != nullptr) {
+    out << ", \"latency_ns\": {";
+    bool first = true;
+    for (const NamedHistogram &named : histograms) {
+      const LatencyHistogram &histogram = *named.histogram;
+      out << (first ? "" : ", ") << "\"" << named.name
+          << "\": {\"count\": " << histogram.Count();
+      for (size_t i = 0; i < 3; i++) {
+        out << ", \"" << kQuantileNames[i]
+            << "\": " << histogram.Percentile(kQuantiles[i]);
+      }
+      out << ", \"max\": " << histogram.Max() << "}";
+      first = false;
+    }
+    out << "}";
+  }
+#ifdef HASH_SET_STATS
+  if (report.stats != nullptr) {
+    PrintStatsJson(*report.stats, out);
+  }
+#endif
+  out << "}" << std::endl;
+}
+
+// The latency columns are left empty when the latencies were not recorded,
+// so that every run has the same columns.
+void PrintCsv(const Report &report,
+              const NamedHistogram (&histograms)[3], std::ostream &out) {
+  out << "program,description,millis,operations,operations_per_second";
+  for (const NamedHistogram &named : histograms) {
+    out << "," << named.name << "_count";
+    for (const char *quantile : kQuantileNames) {
+      out << "," << named.name << "_" << quantile << "_ns";
+    }
+    out << "," << named.name << "_max_ns";
+  }
+  out << std::endl;
+  out << CsvField(report.program) << "," << CsvField(report.description)
+      << "," << report.millis << "," << report.operations << ","
+      << Throughput(report);
+  for (const NamedHistogram &named : histograms) {
+    if (report.latencies == nullptr) {
+      out << ",,,,,";
+      continue;
+    }
+    const LatencyHistogram &histogram = *named.histogram;
+    out << "," << histogram.Count();
+    for (double quantile : kQuantiles) {
+      out << "," << histogram.Percentile(quantile);
+    }
+    out << "," << histogram.Max();
+  }
+  out << std::endl;
+}
+
+} // namespace
+
+bool ParseOutputFormat(const std::string &text, OutputFormat &format) {
+  if (text == "text") {
+    format = OutputFormat::kText;
+  } else if (text == "json") {
+    format = OutputFormat::kJson;
+  } else if (text == "csv") {
+    format = OutputFormat::kCsv;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void PrintReport(const Report &report, OutputFormat format,
+                 std::ostream &out) {
+  static const OperationLatencies kNoLatencies;
+  const OperationLatencies &latencies =
+      report.latencies == nullptr ? kNoLatencies : *report.latencies;
+  const NamedHistogram histograms[3] = {{"add", &latencies.add},
+                                        {"remove", &latencies.remove},
+                                        {"contains", &latencies.contains}};
+  switch (format) {
+  case OutputFormat::kText:
+    PrintText(report, histograms, out);
+    return;
+  case OutputFormat::kJson:
+    PrintJson(report, histograms, out);
+    return;
+  case OutputFormat::kCsv:
+    PrintCsv(report, histograms, out);
+    return;
+  }
+}
+
+} // namespace benchmark
@@ -0,0 +1,47 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "src/hash_set_stats.h"
+#include "src/latency_histogram.h"
+
+namespace benchmark {
+
+enum class OutputFormat {
+  // The human readable report the demos have always printed.
+  kText,
+  // A single JSON object.
+  kJson,
+  // A header line and a single row.
+  kCsv,
+};
+
+// The outcome of a successful benchmark run.
+struct Report {
+  std::string program;
+  // What was run, e.g. the workload, or empty for the fixed script.
+  std::string description;
+  int64_t millis = 0;
+  // The number of operations run, or 0 if they were not counted.
+  size_t operations = 0;
+  // The merged latencies of all the threads, or null if they were not
+  // recorded.
+  const OperationLatencies *latencies = nullptr;
+#ifdef HASH_SET_STATS
+  // The stats of the hash set right after the run, or null.
+  const HashSetStats *stats = nullptr;
+#endif
+};
+
+// Parses the value of an --output= option. Returns false if it is malformed.
+bool ParseOutputFormat(const std::string &text, OutputFormat &format);
+
+void PrintReport(const Report &report, OutputFormat format, std::ostream &out);
+
+} // namespace benchmark
+
+#endif // REPORT_H
@@ -0,0 +1,16 @@
+#ifndef RESIZE_MODE_H
+#define RESIZE_MODE_H
+
+// How the striped and refinable hash sets move their elements when resizing.
+enum class ResizeMode {
+  // The resizing thread rehashes the whole table while every other thread is
+  // blocked.
+  kStopTheWorld,
+  // The resizing thread only swaps in an empty table while every other thread
+  // is blocked. The old and the new table then coexist, and every operation
+  // migrates the old bucket of its element, plus a bounded number of other old
+  // buckets guarded by the same lock, before using the new table.
+  kIncremental,
+};
+
+#endif // RESIZE_MODE_H
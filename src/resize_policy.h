@@ -0,0 +1,103 @@
+#ifndef RESIZE_POLICY_H
+#define RESIZE_POLICY_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <thread>
+
+/*
+ * When a hash set resizes its table, and to how many buckets. The table grows
+ * by growth_factor once there are more than max_load_factor elements per
+ * bucket, and shrinks by growth_factor once there are fewer than
+ * min_load_factor, but never below its initial bucket count. The gap between
+ * the two watermarks is the hysteresis: a table that just grew or shrank is
+ * never due to resize back right away, as long as
+ * min_load_factor * growth_factor <= max_load_factor. A min_load_factor of 0
+ * turns shrinking off.
+ *
+ * The sets with striped locks also grow their lock count with the table, by
+ * growth_factor at a time, up to max_lock_count. The lock count therefore
+ * always divides the bucket count, and a bucket is guarded by a single lock.
+ * By default the cap is kLocksPerThread locks per hardware thread, enough
+ * for threads to rarely share a lock, without a lock per bucket.
+ */
+class ResizePolicy {
+public:
+  static constexpr size_t kLocksPerThread = 8;
+
+  explicit ResizePolicy(size_t max_load_factor = 4, size_t min_load_factor = 1,
+                        size_t growth_factor = 2,
+                        size_t max_lock_count = DefaultMaxLockCount())
+      : max_load_factor_(max_load_factor), min_load_factor_(min_load_factor),
+        growth_factor_(growth_factor), max_lock_count_(max_lock_count) {
+    assert(IsValid(max_load_factor_, min_load_factor_, growth_factor_));
+  }
+
+  [[nodiscard]] static size_t DefaultMaxLockCount() {
+    return kLocksPerThread *
+           std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  // Returns true if the factors make a policy with some hysteresis.
+  [[nodiscard]] static bool IsValid(size_t max_load_factor,
+                                    size_t min_load_factor,
+                                    size_t growth_factor) {
+    return growth_factor >= 2 &&
+           min_load_factor * growth_factor <= max_load_factor;
+  }
+
+  // Returns the bucket count a table of |bucket_count| buckets holding
+  // |elem_count| elements should have, which is |bucket_count| itself unless
+  // it is due to resize.
+  [[nodiscard]] size_t TargetBucketCount(size_t elem_count,
+                                         size_t bucket_count,
+                                         size_t min_bucket_count) const {
+    if (elem_count / bucket_count > max_load_factor_) {
+      return bucket_count * growth_factor_;
+    }
+    if (bucket_count / growth_factor_ >= min_bucket_count &&
+        elem_count < min_load_factor_ * bucket_count) {
+      return bucket_count / growth_factor_;
+    }
+    return bucket_count;
+  }
+
+  // Returns the smallest bucket count, |min_bucket_count| grown by
+  // growth_factor, at which a table holding |elem_count| elements is not due
+  // to grow.
+  [[nodiscard]] size_t BucketCountFor(size_t elem_count,
+                                      size_t min_bucket_count) const {
+    size_t bucket_count = min_bucket_count;
+    while (elem_count / bucket_count > max_load_factor_) {
+      bucket_count *= growth_factor_;
+    }
+    return bucket_count;
+  }
+
+  // Returns the lock count for |bucket_count| buckets guarded so far by
+  // |lock_count| locks, which divides |bucket_count|: |lock_count| grown by
+  // growth_factor as long as it stays within both the bucket count and
+  // max_lock_count. A lock count above the cap to begin with is kept.
+  [[nodiscard]] size_t TargetLockCount(size_t bucket_count,
+                                       size_t lock_count) const {
+    size_t limit = std::min(bucket_count, max_lock_count_);
+    while (lock_count <= limit / growth_factor_) {
+      lock_count *= growth_factor_;
+    }
+    return lock_count;
+  }
+
+  [[nodiscard]] size_t MaxLoadFactor() const { return max_load_factor_; }
+  [[nodiscard]] size_t MinLoadFactor() const { return min_load_factor_; }
+  [[nodiscard]] size_t GrowthFactor() const { return growth_factor_; }
+  [[nodiscard]] size_t MaxLockCount() const { return max_lock_count_; }
+
+private:
+  size_t max_load_factor_;
+  size_t min_load_factor_;
+  size_t growth_factor_;
+  size_t max_lock_count_;
+};
+
+#endif // RESIZE_POLICY_H
@@ -10,22 +10,21 @@
 
 // auxiliary class for locking a vector of mutexes and unlocking them at the end
 // of the scope
-class ScopedVectorLock {
+template <typename Mutex = std::mutex> class ScopedVectorLock {
 public:
-  explicit ScopedVectorLock(std::vector<std::mutex> &mutexes)
-      : mutexes_(mutexes) {
-    for (std::mutex &mutex : mutexes_) {
+  explicit ScopedVectorLock(std::vector<Mutex> &mutexes) : mutexes_(mutexes) {
+    for (Mutex &mutex : mutexes_) {
       mutex.lock();
     }
   }
   ~ScopedVectorLock() {
-    for (std::mutex &mutex : mutexes_) {
+    for (Mutex &mutex : mutexes_) {
       mutex.unlock();
     }
   }
 
 private:
-  std::vector<std::mutex> &mutexes_;
+  std::vector<Mutex> &mutexes_;
 };
 
 #endif // HASHSETS_SCOPED_VECTOR_LOCK_H
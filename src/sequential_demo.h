@@ -0,0 +1,54 @@
+#ifndef SEQUENTIAL_DEMO_H
+#define SEQUENTIAL_DEMO_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// The demo of a single-threaded hash set: adds the ints below |count| to a
+// |HashSetType| of |initial_capacity|, both from the command line, and then
+// checks and removes them one by one. |name| names the set in the message
+// printed on success.
+template <typename HashSetType>
+int RunSequentialDemo(int argc, char **argv, const char *name) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " initial_capacity count" << std::endl;
+    return 1;
+  }
+  size_t initial_capacity = std::stoul(std::string(argv[1]));
+  size_t count = std::stoul(std::string(argv[2]));
+
+  HashSetType hash_set(initial_capacity);
+
+  for (size_t i = 0; i < count; i++) {
+    hash_set.Add(static_cast<int>(i));
+  }
+  if (hash_set.Size() != count) {
+    std::cerr << "Expected size " << count << ", got " << hash_set.Size()
+              << std::endl;
+    return 1;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (hash_set.Size() != count - i) {
+      std::cerr << "Expected size " << (count - i) << ", got "
+                << hash_set.Size() << std::endl;
+    }
+    int expected_value = static_cast<int>(i);
+    if (!hash_set.Contains(expected_value)) {
+      std::cerr << "Expected value " << expected_value << std::endl;
+      return 1;
+    }
+    hash_set.Remove(expected_value);
+  }
+  if (hash_set.Size() != 0) {
+    std::cerr << "Expected empty set, got set with size " << hash_set.Size()
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << name << " hash set tests succeeded" << std::endl;
+
+  return 0;
+}
+
+#endif // SEQUENTIAL_DEMO_H
@@ -0,0 +1,66 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "src/cache_aligned.h"
+#include "src/hash_functions.h"
+
+/*
+ * An element count split into shards that each sit on a cache line of their
+ * own, so that Add and Remove on elements of different shards never write to
+ * the same cache line. The shard of an element is picked from its hash like a
+ * bucket, so an element is always counted and uncounted on the same shard,
+ * and since both happen under the lock of the element a shard never goes
+ * below zero.
+ */
+class ShardedCounter {
+public:
+  // We use one shard per initial bucket up to kMaxShardCount, which keeps
+  // summing the shards cheap for large tables.
+  explicit ShardedCounter(size_t capacity)
+      : shards_(std::clamp<size_t>(capacity, 1, kMaxShardCount)) {}
+
+  [[nodiscard]] size_t ShardOf(size_t hash) const {
+    return BucketIndex(hash, shards_.size());
+  }
+
+  [[nodiscard]] size_t ShardCount() const { return shards_.size(); }
+
+  void Add(size_t shard, size_t n = 1) {
+    shards_[shard].count_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void Sub(size_t shard, size_t n = 1) {
+    shards_[shard].count_.fetch_sub(n, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t Get(size_t shard) const {
+    return shards_[shard].count_.load(std::memory_order_relaxed);
+  }
+
+  // Sums the shards with relaxed loads. While other threads add and remove
+  // elements the result is approximate, as some of their updates may be
+  // included and others not, but it is exact once they are done.
+  [[nodiscard]] size_t Sum() const {
+    size_t sum = 0;
+    for (const Shard &shard : shards_) {
+      sum += shard.count_.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+private:
+  static constexpr size_t kMaxShardCount = 64;
+
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<size_t> count_{0};
+  };
+
+  std::vector<Shard> shards_;
+};
+
+#endif // SHARDED_COUNTER_H
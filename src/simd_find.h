@@ -0,0 +1,111 @@
+#ifndef SIMD_FIND_H
+#define SIMD_FIND_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * A bucket scan that compares several integer keys at once, for buckets kept
+ * in fixed-size arrays. For 32-bit and 64-bit integers, FindIndex compares 32
+ * bytes of keys per instruction with AVX2 and 16 bytes with SSE2 (SSE4.1 for
+ * 64-bit keys), and whatever is left over with std::find. Which of them is
+ * used is decided at compile time from the target, which -march=native sets
+ * in the Release build, and any other type or target only uses std::find.
+ *
+ * The chained hash sets keep std::find: their buckets are vectors of a few
+ * elements, whose length varies from bucket to bucket, and there the vector
+ * compares do not pay for the branches around them.
+ */
+
+// Whether FindIndex compares |T| keys with vector instructions.
+template <typename T>
+constexpr bool kSimdFindable =
+    std::is_integral_v<T> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+// The bits of a movemask that belong to the first |lanes| keys of |T|.
+template <typename T> unsigned LaneMask(size_t lanes) {
+  size_t bits = lanes * sizeof(T);
+  return bits >= 32 ? ~0u : (1u << bits) - 1;
+}
+
+// Returns the index of the first of the |count| elements at |elems| that is
+// equal to |elem|, or |count| if none is. The elements up to |readable| may be
+// loaded as well, which lets a short bucket in a fixed-size array be compared
+// with one vector, but they never match. The matches past |count| are masked
+// off rather than branched around, since the bucket sizes are unpredictable.
+template <typename T>
+size_t FindIndex(const T *elems, size_t count, const T &elem,
+                 size_t readable) {
+  assert(count <= readable);
+  size_t i = 0;
+  if constexpr (kSimdFindable<T>) {
+#if defined(__AVX2__)
+    constexpr size_t kWideLanes = sizeof(__m256i) / sizeof(T);
+    __m256i wide_needle =
+        sizeof(T) == 4 ? _mm256_set1_epi32(static_cast<int>(elem))
+                       : _mm256_set1_epi64x(static_cast<long long>(elem));
+    for (; i + kWideLanes <= readable; i += kWideLanes) {
+      __m256i keys = _mm256_loadu_si256(
+          static_cast<const __m256i *>(static_cast<const void *>(elems + i)));
+      __m256i equal = sizeof(T) == 4
+                          ? _mm256_cmpeq_epi32(keys, wide_needle)
+                          : _mm256_cmpeq_epi64(keys, wide_needle);
+      unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(equal)) &
+                      LaneMask<T>(count - i);
+      if (mask != 0) {
+        return i + static_cast<size_t>(__builtin_ctz(mask)) / sizeof(T);
+      }
+      if (i + kWideLanes >= count) {
+        return count;
+      }
+    }
+#endif
+#if defined(__SSE2__)
+    if constexpr (sizeof(T) == 4) {
+      constexpr size_t kLanes = sizeof(__m128i) / sizeof(T);
+      __m128i needle = _mm_set1_epi32(static_cast<int>(elem));
+      for (; i + kLanes <= readable; i += kLanes) {
+        __m128i keys = _mm_loadu_si128(
+            static_cast<const __m128i *>(static_cast<const void *>(elems + i)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                            _mm_cmpeq_epi32(keys, needle))) &
+                        LaneMask<T>(count - i);
+        if (mask != 0) {
+          return i + static_cast<size_t>(__builtin_ctz(mask)) / sizeof(T);
+        }
+        if (i + kLanes >= count) {
+          return count;
+        }
+      }
+    }
+#endif
+#if defined(__SSE4_1__)
+    if constexpr (sizeof(T) == 8) {
+      constexpr size_t kLanes = sizeof(__m128i) / sizeof(T);
+      __m128i needle = _mm_set1_epi64x(static_cast<long long>(elem));
+      for (; i + kLanes <= readable; i += kLanes) {
+        __m128i keys = _mm_loadu_si128(
+            static_cast<const __m128i *>(static_cast<const void *>(elems + i)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                            _mm_cmpeq_epi64(keys, needle))) &
+                        LaneMask<T>(count - i);
+        if (mask != 0) {
+          return i + static_cast<size_t>(__builtin_ctz(mask)) / sizeof(T);
+        }
+        if (i + kLanes >= count) {
+          return count;
+        }
+      }
+    }
+#endif
+  }
+  return static_cast<size_t>(std::find(elems + i, elems + count, elem) - elems);
+}
+
+#endif // SIMD_FIND_H
@@ -0,0 +1,160 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Memory from operator new.
+class HeapMemory {
+public:
+  void *Allocate(size_t bytes, size_t align) {
+    return ::operator new(bytes, std::align_val_t(align));
+  }
+
+  void Deallocate(void *memory, size_t bytes, size_t align) {
+    ::operator delete(memory, bytes, std::align_val_t(align));
+  }
+};
+
+/*
+ * A pool of blocks carved out of large slabs, for the storage of the buckets
+ * of a hash set. Requests are rounded up to a power-of-two size class, and a
+ * freed block goes onto the free list of its class, from which the next
+ * request of that class is served. Buckets freed by one resize are therefore
+ * reused by the buckets of the next, instead of going back to malloc, and the
+ * slabs are only freed, all together, when the pool is destroyed. Requests
+ * larger than kMaxBlockSize, or aligned more strictly than a slab, go
+ * straight to |Memory|, as do the slabs themselves. |Memory| is HeapMemory,
+ * that is operator new, unless the memory has to come from somewhere else,
+ * such as the NodeMemory of node_memory.h.
+ *
+ * The pool is not thread safe: the hash sets give each lock its own pool, so
+ * that a pool is only used by the thread holding that lock.
+ */
+template <typename Memory = HeapMemory> class SlabPool {
+public:
+  explicit SlabPool(Memory memory = Memory()) : memory_(std::move(memory)) {}
+
+  ~SlabPool() {
+    for (void *slab : slabs_) {
+      memory_.Deallocate(slab, kSlabSize, kBlockAlignment);
+    }
+  }
+
+  SlabPool(const SlabPool &) = delete;
+  SlabPool &operator=(const SlabPool &) = delete;
+
+  void *Allocate(size_t bytes, size_t align) {
+    if (bytes > kMaxBlockSize || align > kBlockAlignment) {
+      return memory_.Allocate(bytes, align);
+    }
+    size_t size_class = SizeClass(bytes);
+    FreeBlock *block = free_lists_[size_class];
+    if (block != nullptr) {
+      free_lists_[size_class] = block->next;
+      return block;
+    }
+    size_t block_size = kMinBlockSize << size_class;
+    if (remaining_ < block_size) {
+      // The tail of the previous slab is left unused, which wastes less than
+      // a block of the largest class per slab.
+      cursor_ = static_cast<std::byte *>(
+          memory_.Allocate(kSlabSize, kBlockAlignment));
+      slabs_.push_back(cursor_);
+      remaining_ = kSlabSize;
+    }
+    void *result = cursor_;
+    cursor_ += block_size;
+    remaining_ -= block_size;
+    return result;
+  }
+
+  void Deallocate(void *block, size_t bytes, size_t align) {
+    if (bytes > kMaxBlockSize || align > kBlockAlignment) {
+      memory_.Deallocate(block, bytes, align);
+      return;
+    }
+    size_t size_class = SizeClass(bytes);
+    free_lists_[size_class] = new (block) FreeBlock{free_lists_[size_class]};
+  }
+
+private:
+  static constexpr size_t kMinBlockSize = 16;
+  static constexpr size_t kClassCount = 9;
+  static constexpr size_t kMaxBlockSize = kMinBlockSize << (kClassCount - 1);
+  static constexpr size_t kSlabSize = 64 * 1024;
+  // Every block size is a multiple of kMinBlockSize, so the blocks of a slab
+  // from operator new keep its alignment.
+  static constexpr size_t kBlockAlignment =
+      std::min(kMinBlockSize, alignof(std::max_align_t));
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  Memory memory_;
+  std::array<FreeBlock *, kClassCount> free_lists_{};
+  std::vector<std::byte *> slabs_;
+  // The part of the last slab that no block has been carved from yet.
+  std::byte *cursor_ = nullptr;
+  size_t remaining_ = 0;
+
+  static size_t SizeClass(size_t bytes) {
+    size_t size_class = 0;
+    while ((kMinBlockSize << size_class) < bytes) {
+      size_class++;
+    }
+    return size_class;
+  }
+};
+
+// A standard allocator backed by a SlabPool. A default-constructed allocator
+// creates a pool of its own, with a default-constructed |Memory|, which its
+// copies share and which lives as long as any of them.
+template <typename T, typename Memory = HeapMemory> class SlabAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  SlabAllocator() : pool_(std::make_shared<SlabPool<Memory>>()) {}
+
+  template <typename U>
+  SlabAllocator(const SlabAllocator<U, Memory> &other) : pool_(other.pool_) {}
+
+  T *allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    return static_cast<T *>(pool_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *block, size_t n) {
+    pool_->Deallocate(block, n * sizeof(T), alignof(T));
+  }
+
+  template <typename U>
+  bool operator==(const SlabAllocator<U, Memory> &other) const {
+    return pool_ == other.pool_;
+  }
+
+  template <typename U>
+  bool operator!=(const SlabAllocator<U, Memory> &other) const {
+    return pool_ != other.pool_;
+  }
+
+private:
+  template <typename, typename> friend class SlabAllocator;
+
+  std::shared_ptr<SlabPool<Memory>> pool_;
+};
+
+#endif // SLAB_ALLOCATOR_H
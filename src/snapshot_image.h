@@ -0,0 +1,214 @@
+#ifndef SNAPSHOT_IMAGE_H
+#define SNAPSHOT_IMAGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/hash_functions.h"
+
+/*
+ * An on-disk image of a hash set, which is looked up in place once mapped
+ * into memory, without reading it into a hash set first. The file is
+ *
+ *   a SnapshotHeader;
+ *   bucket_count + 1 offsets, as uint64_t, where the keys of bucket i are
+ *     the keys from offset i up to offset i + 1;
+ *   elem_count keys, bucket by bucket, each stored as its sizeof(T) bytes.
+ *
+ * The key of an element is its object representation, so the element type
+ * must be trivially copyable, and the image must be read on a machine with
+ * the same byte order, size of T and hash function as the machine that wrote
+ * it. A key belongs to bucket BucketIndex(hash(key), bucket_count), as in the
+ * hash sets, which is why SnapshotImage takes the Hash of the writer.
+ */
+struct SnapshotHeader {
+  // Also tells apart files written in the other byte order.
+  static constexpr uint64_t kMagic = 0x50414e5348534148; // "HASHSNAP"
+  static constexpr uint32_t kVersion = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint64_t bucket_count;
+  uint64_t elem_count;
+};
+
+// The keys of every image start at a multiple of 8 bytes.
+template <typename T>
+constexpr bool kSnapshotStorable =
+    std::is_trivially_copyable_v<T> && alignof(T) <= alignof(uint64_t);
+
+// The bucket count of the image of |elem_count| elements: a power of two, so
+// that lookups index with a bitmask, with at most two keys per bucket on
+// average.
+inline size_t SnapshotBucketCount(size_t elem_count) {
+  size_t bucket_count = 1;
+  while (bucket_count * 2 < elem_count) {
+    bucket_count *= 2;
+  }
+  return bucket_count;
+}
+
+// Writes the image of |elems|, which must be distinct, to |path|. The image
+// is written to a temporary file next to |path| first, and renamed over it
+// once complete, so that a crash never leaves a partial image behind.
+// Returns false if any write failed.
+template <typename T, typename Hash = std::hash<T>>
+bool WriteSnapshot(const std::string &path, const std::vector<T> &elems,
+                   const Hash &hash = Hash()) {
+  static_assert(kSnapshotStorable<T>, "The keys are stored as their bytes");
+  size_t bucket_count = SnapshotBucketCount(elems.size());
+  // The keys are sorted by bucket with a counting sort.
+  std::vector<uint64_t> offsets(bucket_count + 1, 0);
+  std::vector<size_t> buckets(elems.size());
+  for (size_t i = 0; i < elems.size(); i++) {
+    buckets[i] = BucketIndex(hash(elems[i]), bucket_count);
+    offsets[buckets[i] + 1]++;
+  }
+  for (size_t i = 0; i < bucket_count; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<T> keys(elems.size());
+  std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < elems.size(); i++) {
+    keys[next[buckets[i]]++] = elems[i];
+  }
+
+  SnapshotHeader header{SnapshotHeader::kMagic, SnapshotHeader::kVersion,
+                        sizeof(T), bucket_count, elems.size()};
+  std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(offsets.data()),
+               static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+    file.write(reinterpret_cast<const char *>(keys.data()),
+               static_cast<std::streamsize>(keys.size() * sizeof(T)));
+    file.close();
+    if (!file) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+// A read-only image written by WriteSnapshot, mapped into memory. Lookups
+// only read the offsets and the keys of their bucket, so they work as soon as
+// the image is mapped, and the pages they touch are read from the file on
+// first use. Any number of threads may look it up at once.
+template <typename T, typename Hash = std::hash<T>> class SnapshotImage {
+public:
+  static_assert(kSnapshotStorable<T>, "The keys are stored as their bytes");
+
+  // Maps the image at |path|. Returns null if the file cannot be mapped, or
+  // is not an image of |T| keys.
+  static std::unique_ptr<SnapshotImage> Map(const std::string &path,
+                                            Hash hash = Hash()) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat status {};
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+      size = static_cast<size_t>(status.st_size);
+      data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping keeps the file open.
+    close(fd);
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+    if (!IsImage(data, size)) {
+      munmap(data, size);
+      return nullptr;
+    }
+    return std::unique_ptr<SnapshotImage>(
+        new SnapshotImage(data, size, std::move(hash)));
+  }
+
+  ~SnapshotImage() { munmap(data_, size_); }
+
+  SnapshotImage(const SnapshotImage &) = delete;
+  SnapshotImage &operator=(const SnapshotImage &) = delete;
+
+  [[nodiscard]] bool Contains(const T &elem) const {
+    size_t my_bucket = BucketIndex(hash_(elem), bucket_count_);
+    uint64_t begin = offsets_[my_bucket];
+    uint64_t end = offsets_[my_bucket + 1];
+    // The offsets are not checked when mapping, since that would read all of
+    // them, so a corrupt image is caught here instead.
+    if (begin > end || end > elem_count_) {
+      return false;
+    }
+    return std::find(keys_ + begin, keys_ + end, elem) != keys_ + end;
+  }
+
+  [[nodiscard]] size_t Size() const { return elem_count_; }
+
+  // The keys, bucket by bucket.
+  [[nodiscard]] const T *begin() const { return keys_; }
+  [[nodiscard]] const T *end() const { return keys_ + elem_count_; }
+
+private:
+  void *data_;
+  size_t size_;
+  Hash hash_;
+  size_t bucket_count_;
+  size_t elem_count_;
+  const uint64_t *offsets_;
+  const T *keys_;
+
+  SnapshotImage(void *data, size_t size, Hash hash)
+      : data_(data), size_(size), hash_(std::move(hash)) {
+    const auto *header = static_cast<const SnapshotHeader *>(data_);
+    bucket_count_ = header->bucket_count;
+    elem_count_ = header->elem_count;
+    offsets_ = reinterpret_cast<const uint64_t *>(header + 1);
+    keys_ = reinterpret_cast<const T *>(offsets_ + bucket_count_ + 1);
+  }
+
+  // Whether the |size| bytes at |data| hold a header for |T| keys, and are
+  // exactly as long as it says.
+  static bool IsImage(const void *data, size_t size) {
+    if (size < sizeof(SnapshotHeader)) {
+      return false;
+    }
+    const auto *header = static_cast<const SnapshotHeader *>(data);
+    if (header->magic != SnapshotHeader::kMagic ||
+        header->version != SnapshotHeader::kVersion ||
+        header->key_size != sizeof(T) || header->bucket_count == 0) {
+      return false;
+    }
+    size_t room = (size - sizeof(SnapshotHeader)) / sizeof(uint64_t);
+    if (header->bucket_count >= room) {
+      return false;
+    }
+    size_t keys_size =
+        size - sizeof(SnapshotHeader) -
+        static_cast<size_t>(header->bucket_count + 1) * sizeof(uint64_t);
+    if (keys_size != header->elem_count * sizeof(T) ||
+        keys_size / sizeof(T) != header->elem_count) {
+      return false;
+    }
+    const auto *offsets = reinterpret_cast<const uint64_t *>(header + 1);
+    return offsets[header->bucket_count] == header->elem_count;
+  }
+};
+
+#endif // SNAPSHOT_IMAGE_H
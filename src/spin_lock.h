@@ -0,0 +1,144 @@
+#ifndef SPIN_LOCK_H
+#define SPIN_LOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * A mutex for critical sections as short as those of the stripe locks, such
+ * as a bucket scan and a push_back, which spins for a while before it sleeps.
+ * A thread that finds the lock taken waits with plain loads, which hit its own
+ * copy of the cache line until the holder releases it, and only then tries to
+ * take it with a compare-exchange (test-and-test-and-set). Between its
+ * attempts it backs off exponentially, so that the waiters do not all retry
+ * at once.
+ *
+ * How long it spins adapts to the lock: each lock keeps a running estimate of
+ * how many rounds of backoff waiters needed, and waiters spin for about twice
+ * that, as glibc's adaptive mutexes do. A waiter that spins in vain lowers the
+ * estimate, so that locks held for long mostly park right away. Past its
+ * spinning, a waiter parks, on a futex on Linux and by yielding elsewhere,
+ * until an unlock wakes it. The state is 0 when unlocked, 1 when locked, and
+ * 2 when locked with waiters that may be parked, which unlock then wakes, as
+ * in Drepper's "Futexes Are Tricky".
+ *
+ * It is Lockable, so it can be the Mutex of the hash sets, wrapped in
+ * CacheAligned for a cache line per stripe as std::mutex is by default.
+ * Spinning pays when the holder is running, so std::mutex stays the default:
+ * oversubscribed machines, with more threads than cores, park either way.
+ */
+class SpinLock {
+public:
+  SpinLock() = default;
+
+  SpinLock(const SpinLock &) = delete;
+  SpinLock &operator=(const SpinLock &) = delete;
+
+  void lock() {
+    if (try_lock()) {
+      return;
+    }
+    int32_t estimate = spin_estimate_.load(std::memory_order_relaxed);
+    int32_t max_rounds =
+        std::min(kMaxSpinRounds, kMinSpinRounds + 2 * estimate / kScale);
+    uint32_t pauses = 1;
+    for (int32_t round = 1; round <= max_rounds; round++) {
+      for (uint32_t i = 0; i < pauses; i++) {
+        Pause();
+      }
+      pauses = std::min(pauses * 2, kMaxPauses);
+      if (try_lock()) {
+        Adapt(estimate, round * kScale);
+        return;
+      }
+    }
+    Adapt(estimate, 0);
+    // Marking the lock contended before parking makes its holder wake us.
+    while (state_.exchange(kContended, std::memory_order_acquire) !=
+           kUnlocked) {
+      Park();
+    }
+  }
+
+  [[nodiscard]] bool try_lock() {
+    uint32_t expected = kUnlocked;
+    return state_.load(std::memory_order_relaxed) == kUnlocked &&
+           state_.compare_exchange_strong(expected, kLocked,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    if (state_.exchange(kUnlocked, std::memory_order_release) == kContended) {
+      Wake();
+    }
+  }
+
+private:
+  static constexpr uint32_t kUnlocked = 0;
+  static constexpr uint32_t kLocked = 1;
+  static constexpr uint32_t kContended = 2;
+
+  // The rounds of backoff a waiter spins for, the i-th of which pauses
+  // min(2^i, kMaxPauses) times: a few microseconds at most, about the cost of
+  // parking and being woken.
+  static constexpr int32_t kMinSpinRounds = 4;
+  static constexpr int32_t kMaxSpinRounds = 12;
+  static constexpr uint32_t kMaxPauses = 32;
+  // The estimate is kept in 1/kScale rounds, so that it moves by less than a
+  // round at a time.
+  static constexpr int32_t kScale = 16;
+
+  std::atomic<uint32_t> state_{kUnlocked};
+  static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "The futex is the state itself");
+  // The running estimate of the rounds waiters spun for, scaled by kScale.
+  // Waiters update it racily, which only blurs the average.
+  std::atomic<int32_t> spin_estimate_{0};
+
+  // Moves the estimate a quarter of the way to |rounds|, scaled by kScale.
+  void Adapt(int32_t estimate, int32_t rounds) {
+    spin_estimate_.store(estimate + (rounds - estimate) / 4,
+                         std::memory_order_relaxed);
+  }
+
+  static void Pause() {
+#if defined(__SSE2__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+  }
+
+  // Sleeps while the lock is still contended. It may return early, as the
+  // caller checks the lock again.
+  void Park() {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_),
+            FUTEX_WAIT_PRIVATE, kContended, nullptr, nullptr, 0);
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  void Wake() {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_),
+            FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+  }
+};
+
+#endif // SPIN_LOCK_H
@@ -0,0 +1,84 @@
+#ifndef STRIPE_SCAN_H
+#define STRIPE_SCAN_H
+
+#include <cstddef>
+#include <vector>
+
+#include "src/hash_functions.h"
+
+/*
+ * The progress of a scan over a hash set with striped locks, which holds one
+ * lock at a time while the lock count may change in between.
+ *
+ * Every lock count of such a hash set divides its largest lock count, so we
+ * split the elements into fine stripes by their hash modulo that largest
+ * count. A fine stripe never changes, whatever the lock count, and the lock s
+ * out of L guards exactly the fine stripes congruent to s modulo L. The scan
+ * visits each fine stripe under a single lock, and marks it visited, so it
+ * never visits an element twice, and visits every element that is present
+ * throughout the scan. The elements added or removed meanwhile are visited at
+ * most once.
+ *
+ * A scan may be restricted to the fine stripes whose index modulo the lock
+ * count when it started is in [begin, end), so that several scans of disjoint
+ * ranges cover the hash set.
+ */
+class StripeScan {
+public:
+  StripeScan(size_t max_lock_count, size_t lock_count, size_t begin,
+             size_t end)
+      : pending_(max_lock_count, false), next_(0) {
+    for (size_t first = 0; first < max_lock_count; first += lock_count) {
+      for (size_t i = first + begin; i < first + end; i++) {
+        pending_[i] = true;
+      }
+    }
+    Skip();
+  }
+
+  [[nodiscard]] bool Done() const { return next_ == pending_.size(); }
+
+  // A fine stripe that is still to be visited, for the caller to lock. The
+  // scan must not be done.
+  [[nodiscard]] size_t Next() const { return next_; }
+
+  // Whether every fine stripe guarded by the lock |lock| out of |lock_count|
+  // is still to be visited, in which case every element of the lock is, and
+  // need not be checked with Visits.
+  [[nodiscard]] bool VisitsWholeLock(size_t lock, size_t lock_count) const {
+    for (size_t i = lock; i < pending_.size(); i += lock_count) {
+      if (!pending_[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Whether the element with |hash| is still to be visited.
+  [[nodiscard]] bool Visits(size_t hash) const {
+    return pending_[BucketIndex(hash, pending_.size())];
+  }
+
+  // Marks the fine stripes guarded by the lock |lock| out of |lock_count|
+  // visited, once the caller has visited their elements under that lock.
+  void MarkVisited(size_t lock, size_t lock_count) {
+    for (size_t i = lock; i < pending_.size(); i += lock_count) {
+      pending_[i] = false;
+    }
+    Skip();
+  }
+
+private:
+  // Whether each fine stripe is in the range of the scan and not visited yet.
+  std::vector<bool> pending_;
+  // The first fine stripe still to be visited.
+  size_t next_;
+
+  void Skip() {
+    while (next_ < pending_.size() && !pending_[next_]) {
+      next_++;
+    }
+  }
+};
+
+#endif // STRIPE_SCAN_H
@@ -0,0 +1,180 @@
+#include "src/workload.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace benchmark {
+
+bool ParseSize(const std::string &text, size_t &value) {
+  if (text.empty() || text[0] < '0' || text[0] > '9') {
+    return false;
+  }
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+  if (errno != 0 || *end != '\0') {
+    return false;
+  }
+  value = static_cast<size_t>(parsed);
+  return true;
+}
+
+namespace {
+
+// Parses a read:insert:delete mix such as 90:5:5.
+bool ParseMix(const std::string &text, WorkloadConfig &config) {
+  size_t first = text.find(':');
+  size_t second =
+      first == std::string::npos ? first : text.find(':', first + 1);
+  if (second == std::string::npos) {
+    return false;
+  }
+  size_t read_percent;
+  size_t insert_percent;
+  size_t delete_percent;
+  if (!ParseSize(text.substr(0, first), read_percent) ||
+      !ParseSize(text.substr(first + 1, second - first - 1), insert_percent) ||
+      !ParseSize(text.substr(second + 1), delete_percent) ||
+      read_percent + insert_percent + delete_percent != 100) {
+    return false;
+  }
+  config.read_percent = read_percent;
+  config.insert_percent = insert_percent;
+  config.delete_percent = delete_percent;
+  return true;
+}
+
+bool ParseDistribution(const std::string &text, KeyDistribution &distribution) {
+  for (KeyDistribution candidate :
+       {KeyDistribution::kUniform, KeyDistribution::kZipfian,
+        KeyDistribution::kSequential, KeyDistribution::kHotSet}) {
+    if (text == DistributionName(candidate)) {
+      distribution = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+bool ParseWorkloadOption(const std::string &option, WorkloadConfig &config) {
+  size_t equals = option.find('=');
+  if (equals == std::string::npos) {
+    return false;
+  }
+  std::string name = option.substr(0, equals);
+  std::string value = option.substr(equals + 1);
+  if (name == "--workload") {
+    return ParseDistribution(value, config.distribution);
+  }
+  if (name == "--mix") {
+    return ParseMix(value, config);
+  }
+  if (name == "--key-space") {
+    // The keys are stored as ints.
+    return ParseSize(value, config.key_space) && config.key_space != 0 &&
+           config.key_space <= static_cast<size_t>(INT_MAX);
+  }
+  if (name == "--duration-ms") {
+    size_t millis;
+    if (!ParseSize(value, millis) || millis == 0) {
+      return false;
+    }
+    config.duration = std::chrono::milliseconds(millis);
+    return true;
+  }
+  return false;
+}
+
+const char *DistributionName(KeyDistribution distribution) {
+  switch (distribution) {
+  case KeyDistribution::kUniform:
+    return "uniform";
+  case KeyDistribution::kZipfian:
+    return "zipfian";
+  case KeyDistribution::kSequential:
+    return "sequential";
+  case KeyDistribution::kHotSet:
+    return "hot-set";
+  }
+  return "unknown";
+}
+
+std::string WorkloadDescription(const WorkloadConfig &config) {
+  return "Workload " + std::string(DistributionName(config.distribution)) +
+         ", " + std::to_string(config.read_percent) + ":" +
+         std::to_string(config.insert_percent) + ":" +
+         std::to_string(config.delete_percent) + " mix over " +
+         std::to_string(config.key_space) + " keys";
+}
+
+KeyGenerator::KeyGenerator(const WorkloadConfig &config, double zeta,
+                           size_t id, size_t num_threads)
+    : config_(config), engine_(2 * id), unit_(0.0, 1.0),
+      next_sequential_(config.key_space / num_threads * id), zeta_(zeta),
+      alpha_(1.0 / (1.0 - config.zipf_theta)), eta_(0.0) {
+  if (config_.distribution == KeyDistribution::kZipfian) {
+    double size = static_cast<double>(config_.key_space);
+    double zeta2 = 1.0 + std::pow(0.5, config_.zipf_theta);
+    eta_ = (1.0 - std::pow(2.0 / size, 1.0 - config_.zipf_theta)) /
+           (1.0 - zeta2 / zeta_);
+  }
+}
+
+size_t KeyGenerator::Next() {
+  switch (config_.distribution) {
+  case KeyDistribution::kUniform:
+    return Uniform(0, config_.key_space);
+  case KeyDistribution::kZipfian:
+    return Zipfian();
+  case KeyDistribution::kSequential: {
+    size_t key = next_sequential_;
+    next_sequential_ = (next_sequential_ + 1) % config_.key_space;
+    return key;
+  }
+  case KeyDistribution::kHotSet: {
+    size_t hot_size = std::max<size_t>(
+        1, static_cast<size_t>(config_.hot_fraction *
+                               static_cast<double>(config_.key_space)));
+    if (hot_size >= config_.key_space ||
+        unit_(engine_) < config_.hot_probability) {
+      return Uniform(0, std::min(hot_size, config_.key_space));
+    }
+    return Uniform(hot_size, config_.key_space);
+  }
+  }
+  return 0;
+}
+
+size_t KeyGenerator::Uniform(size_t begin, size_t end) {
+  return std::uniform_int_distribution<size_t>(begin, end - 1)(engine_);
+}
+
+size_t KeyGenerator::Zipfian() {
+  double u = unit_(engine_);
+  double uz = u * zeta_;
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + std::pow(0.5, config_.zipf_theta)) {
+    return std::min<size_t>(1, config_.key_space - 1);
+  }
+  double size = static_cast<double>(config_.key_space);
+  size_t rank = static_cast<size_t>(size * std::pow(eta_ * u - eta_ + 1.0,
+                                                    alpha_));
+  return std::min(rank, config_.key_space - 1);
+}
+
+double Zeta(size_t n, double theta) {
+  double sum = 0.0;
+  for (size_t i = 1; i <= n; i++) {
+    sum += 1.0 / std::pow(static_cast<double>(i), theta);
+  }
+  return sum;
+}
+
+} // namespace benchmark
@@ -0,0 +1,194 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/latency_histogram.h"
+#include "src/numa_topology.h"
+
+namespace benchmark {
+
+// How the keys of a workload are drawn from [0, key_space).
+enum class KeyDistribution {
+  // Every key is equally likely.
+  kUniform,
+  // The key of rank r is drawn with probability proportional to
+  // 1 / (r + 1)^zipf_theta, so that a few keys take most of the traffic.
+  kZipfian,
+  // Each thread walks through its own part of the key space in order.
+  kSequential,
+  // A hot set of the first hot_fraction of the keys takes hot_probability of
+  // the traffic, with both sets uniform.
+  kHotSet,
+};
+
+struct WorkloadConfig {
+  KeyDistribution distribution = KeyDistribution::kUniform;
+  // The percentages of Contains, Add and Remove operations, summing to 100.
+  size_t read_percent = 90;
+  size_t insert_percent = 5;
+  size_t delete_percent = 5;
+  size_t key_space = 0;
+  std::chrono::milliseconds duration{1000};
+  double zipf_theta = 0.99;
+  double hot_fraction = 0.2;
+  double hot_probability = 0.8;
+};
+
+struct WorkloadResult {
+  size_t operations = 0;
+  std::chrono::milliseconds elapsed{0};
+  // The number of elements the hash set should hold afterwards, computed from
+  // the successful Add and Remove operations.
+  size_t expected_size = 0;
+};
+
+// Parses a decimal number that makes up the whole of |text|.
+bool ParseSize(const std::string &text, size_t &value);
+
+// Parses a --workload=, --mix=, --key-space= or --duration-ms= option into
+// |config|. Returns false if |option| is none of them or is malformed.
+bool ParseWorkloadOption(const std::string &option, WorkloadConfig &config);
+
+// Returns the name of |distribution| as accepted by --workload=.
+const char *DistributionName(KeyDistribution distribution);
+
+// Returns the one line description of |config| that the reports print.
+std::string WorkloadDescription(const WorkloadConfig &config);
+
+// Draws the keys of one thread of a workload.
+class KeyGenerator {
+public:
+  KeyGenerator(const WorkloadConfig &config, double zeta, size_t id,
+               size_t num_threads);
+
+  size_t Next();
+
+private:
+  const WorkloadConfig &config_;
+  std::mt19937_64 engine_;
+  std::uniform_real_distribution<double> unit_;
+  size_t next_sequential_;
+  // The Zipfian generator of Gray et al., "Quickly generating billion-record
+  // synthetic databases", which maps a single uniform draw to a rank.
+  double zeta_;
+  double alpha_;
+  double eta_;
+
+  size_t Uniform(size_t begin, size_t end);
+  size_t Zipfian();
+};
+
+// Returns the sum of 1 / i^theta for i in [1, n], which the Zipfian
+// distribution normalises by. It is computed once per run, as it takes time
+// linear in the key space.
+double Zeta(size_t n, double theta);
+
+// Runs operations until |stop| is set, and records how many it ran and by how
+// much they changed the size of the hash set.
+template <typename HashSetType>
+void WorkloadThreadBody(HashSetType &hash_set, const WorkloadConfig &config,
+                        double zeta, size_t id, size_t num_threads,
+                        const std::atomic<bool> &stop,
+                        size_t &operations, size_t &added, size_t &removed,
+                        OperationLatencies *latencies) {
+  LatencyHistogram *add = HistogramOf(latencies, &OperationLatencies::add);
+  LatencyHistogram *remove =
+      HistogramOf(latencies, &OperationLatencies::remove);
+  LatencyHistogram *contains =
+      HistogramOf(latencies, &OperationLatencies::contains);
+  KeyGenerator keys(config, zeta, id, num_threads);
+  // The operations are drawn from an engine of their own, so that the key
+  // sequence of a thread does not depend on the mix.
+  std::mt19937_64 engine(2 * id + 1);
+  std::uniform_int_distribution<size_t> percent(0, 99);
+  operations = 0;
+  added = 0;
+  removed = 0;
+  while (!stop.load(std::memory_order_relaxed)) {
+    int elem = static_cast<int>(keys.Next());
+    size_t draw = percent(engine);
+    if (draw < config.read_percent) {
+      Timed(contains, [&] { return hash_set.Contains(elem); });
+    } else if (draw < config.read_percent + config.insert_percent) {
+      if (Timed(add, [&] { return hash_set.Add(elem); })) {
+        added++;
+      }
+    } else {
+      if (Timed(remove, [&] { return hash_set.Remove(elem); })) {
+        removed++;
+      }
+    }
+    operations++;
+  }
+}
+
+// Adds every other key of the key space to |hash_set|, so that lookups hit
+// about half of the time, and then runs the operation mix of |config| on
+// |num_threads| threads for the configured duration. Unless |latencies| is
+// null, the latencies of the operations are recorded and merged into it. The
+// threads are pinned as |pinning| says.
+template <typename HashSetType>
+WorkloadResult RunWorkload(HashSetType &hash_set, size_t num_threads,
+                           const WorkloadConfig &config,
+                           OperationLatencies *latencies,
+                           ThreadPinning pinning = ThreadPinning::kNone) {
+  WorkloadResult result;
+  for (size_t key = 0; key < config.key_space; key += 2) {
+    if (hash_set.Add(static_cast<int>(key))) {
+      result.expected_size++;
+    }
+  }
+  double zeta = config.distribution == KeyDistribution::kZipfian
+                    ? Zeta(config.key_space, config.zipf_theta)
+                    : 0.0;
+
+  std::vector<size_t> operations(num_threads, 0);
+  std::vector<size_t> added(num_threads, 0);
+  std::vector<size_t> removed(num_threads, 0);
+  std::vector<OperationLatencies> thread_latencies(
+      latencies == nullptr ? 0 : num_threads);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+
+  auto begin_time = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_threads; i++) {
+    OperationLatencies *latencies_of_thread =
+        latencies == nullptr ? nullptr : &thread_latencies[i];
+    threads.emplace_back([&, i, latencies_of_thread] {
+      PinThread(pinning, i);
+      WorkloadThreadBody(hash_set, config, zeta, i, num_threads, stop,
+                         operations[i], added[i], removed[i],
+                         latencies_of_thread);
+    });
+  }
+  std::this_thread::sleep_for(config.duration);
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - begin_time);
+
+  for (size_t i = 0; i < num_threads; i++) {
+    result.operations += operations[i];
+    result.expected_size += added[i];
+    result.expected_size -= removed[i];
+  }
+  for (const OperationLatencies &latencies_of_thread : thread_latencies) {
+    latencies->Merge(latencies_of_thread);
+  }
+  return result;
+}
+
+} // namespace benchmark
+
+#endif // WORKLOAD_H